@@ -4,6 +4,7 @@
 #include "Util.h"
 #include "Endpoint.h"
 #include <cassert>
+#include <cstdint>
 
 
 namespace MiepMiep
@@ -11,13 +12,18 @@ namespace MiepMiep
 	// ------------ BinSerializer ------------------------------------------------------------------------------
 
 	BinSerializer::BinSerializer():
-		m_DataPtr(nullptr)
+		m_DataPtr(m_Inline),
+		m_Heap(nullptr),
+		m_HeapSize(0),
+		m_WritePos(0),
+		m_ReadPos(0),
+		m_MaxSize(InlineBuffSize),
+		m_IntEncoding(EIntEncoding::Fixed)
 	{
-		reset();
 	}
 
 	BinSerializer::BinSerializer(const byte* streamIn, u32 buffSize, u32 writePos, bool copyData, bool ownsData):
-		m_DataPtr(nullptr)
+		BinSerializer()
 	{
 		resetTo(streamIn, buffSize, writePos, copyData, ownsData);
 	}
@@ -25,67 +31,106 @@ namespace MiepMiep
 	BinSerializer::BinSerializer(const BinSerializer& other):
 		BinSerializer()
 	{
-		write(other.data(), other.length());
+		m_IntEncoding = other.m_IntEncoding;
+		if ( other.m_Shared ) view(other.m_Shared, other.data(), other.length());
+		else write(other.data(), other.length());
 	}
 
-	BinSerializer::BinSerializer(BinSerializer&& other) noexcept
+	BinSerializer::BinSerializer(BinSerializer&& other) noexcept:
+		BinSerializer()
 	{
 		*this = move(other);
 	}
 
 	BinSerializer& BinSerializer::operator=(const BinSerializer& other)
 	{
+		m_IntEncoding = other.m_IntEncoding;
 		write(other.data(), other.length());
 		return *this;
 	}
 
 	BinSerializer& BinSerializer::operator=(BinSerializer&& other) noexcept
 	{
-		Platform::copy( this, &other, 1 );
-		other.m_DataPtr = nullptr;
+		if ( this == &other ) return *this;
+		releaseN(m_Heap);
+		m_Heap		= other.m_Heap;
+		m_HeapSize	= other.m_HeapSize;
+		m_WritePos	= other.m_WritePos;
+		m_ReadPos	= other.m_ReadPos;
+		m_MaxSize	= other.m_MaxSize;
+		m_IntEncoding = other.m_IntEncoding;
+		m_Shared	= move(other.m_Shared);
+		if ( other.m_DataPtr == other.m_Inline )
+		{
+			Platform::copy(m_Inline, other.m_Inline, m_WritePos);
+			m_DataPtr = m_Inline;
+		}
+		else
+		{
+			m_DataPtr = other.m_DataPtr;
+		}
+		other.m_Heap	 = nullptr;
+		other.m_HeapSize = 0;
+		other.reset();
 		return *this;
 	}
 
 	BinSerializer::~BinSerializer()
 	{
-		reset();
+		releaseN(m_Heap);
 	}
 
 	void BinSerializer::reset()
 	{
-		if ( m_Owns )
+		// Keep the buffer for the next message, unless it is very large.
+		if ( m_HeapSize > KeepBuffSize )
 		{
-			releaseN(m_DataPtr);
+			releaseN(m_Heap);
+			m_Heap	   = nullptr;
+			m_HeapSize = 0;
 		}
-		m_DataPtr  = nullptr;
+		m_DataPtr  = m_Heap ? m_Heap : m_Inline;
+		m_MaxSize  = m_Heap ? m_HeapSize : InlineBuffSize;
 		m_WritePos = 0;
 		m_ReadPos  = 0;
-		m_MaxSize  = 0;
-		m_Owns = true;
+		m_Shared   = nullptr;
 	}
 
 	void BinSerializer::resetTo(const byte* streamIn, u32 buffSize, u32 writePos, bool copyData, bool ownsData)
 	{
-		if ( m_Owns && !copyData )
-		{
-			Memory::doDeleteN(m_DataPtr);
-			m_DataPtr = nullptr;
-		}
+		assert(writePos<=buffSize && streamIn!=nullptr);
+		sptr<const byte> prevShared = move(m_Shared); // 'streamIn' may point into it.
 		if ( !copyData )
 		{
+			if ( ownsData )
+			{
+				releaseN(m_Heap);
+				m_Heap	   = scc<byte*>( streamIn );
+				m_HeapSize = buffSize;
+			}
 			m_DataPtr  = scc<byte*>( streamIn );
-			m_WritePos = writePos;
 			m_MaxSize  = buffSize;
+			m_WritePos = writePos;
+			m_ReadPos  = 0;
 		}
 		else
 		{
-			growTo(buffSize);
+			reset();
+			reserve(buffSize);
 			Platform::memCpy(m_DataPtr, buffSize, streamIn, buffSize);
 			m_WritePos = writePos;
 		}
-		m_Owns = ownsData;
-		m_ReadPos = 0;
-		assert(m_WritePos>=0 && m_WritePos<=m_MaxSize && m_DataPtr!=nullptr);
+	}
+
+	void BinSerializer::view(const sptr<const byte>& owner, const byte* data, u32 length)
+	{
+		resetTo(data, length, length);
+		m_Shared = owner;
+	}
+
+	bool BinSerializer::reserve(u32 size)
+	{
+		return size <= m_MaxSize || grow(size);
 	}
 
 	bool BinSerializer::setRead(u32 r)
@@ -97,7 +142,8 @@ namespace MiepMiep
 
 	bool BinSerializer::setWrite(u32 w)
 	{
-		if ( w > m_MaxSize ) return false;
+		if ( w > m_MaxSize && !grow(w) ) return false;
+		if ( m_Shared && w < m_WritePos && !grow(m_MaxSize) ) return false; // Shared bytes would be overwritten.
 		m_WritePos = w;
 		return true;
 	}
@@ -114,16 +160,14 @@ namespace MiepMiep
 
 	bool BinSerializer::write8(byte b)
 	{
-		growTo(m_WritePos + 1);
-		if ( m_WritePos + 1 > m_MaxSize ) return false;
+		if ( m_WritePos + 1 > m_MaxSize && !grow(m_WritePos + 1) ) return false;
 		pr_data()[m_WritePos++] = b;
 		return true;
 	}
 
 	bool BinSerializer::write16(u16 b)
 	{
-		growTo(m_WritePos + 2);
-		if ( m_WritePos + 2 > m_MaxSize ) return false;
+		if ( m_WritePos + 2 > m_MaxSize && !grow(m_WritePos + 2) ) return false;
 		*rc<u16*>(pr_data() + m_WritePos) = Util::htons(b);
 		m_WritePos += 2;
 		return true;
@@ -131,8 +175,7 @@ namespace MiepMiep
 
 	bool BinSerializer::write32(u32 b)
 	{
-		growTo(m_WritePos + 4);
-		if ( m_WritePos + 4 > m_MaxSize ) return false;
+		if ( m_WritePos + 4 > m_MaxSize && !grow(m_WritePos + 4) ) return false;
 		*rc<u32*>(pr_data() + m_WritePos) = Util::htonl(b);
 		m_WritePos += 4;
 		return true;
@@ -140,8 +183,7 @@ namespace MiepMiep
 
 	bool BinSerializer::write64(u64 b)
 	{
-		growTo(m_WritePos + 8);
-		if ( m_WritePos + 8 > m_MaxSize ) return false;
+		if ( m_WritePos + 8 > m_MaxSize && !grow(m_WritePos + 8) ) return false;
 		*rc<u64*>(pr_data() + m_WritePos) = Util::htonll(b);
 		m_WritePos += 8;
 		return true;
@@ -195,13 +237,109 @@ namespace MiepMiep
 
 	bool BinSerializer::write(const byte* b, u32 buffSize)
 	{
-		growTo(m_WritePos + buffSize);
-		if ( m_WritePos + buffSize > m_MaxSize ) return false; // if data is not owned, it doenst grow
+		if ( m_WritePos + buffSize > m_MaxSize && !grow(m_WritePos + buffSize) ) return false; // if data is not owned, it doenst grow
 		Platform::copy(pr_data()+m_WritePos, b, buffSize);
 		m_WritePos += buffSize;
 		return true;
 	}
 
+	bool BinSerializer::readVarint(u32& v)
+	{
+		return readLeb(v);
+	}
+
+	bool BinSerializer::readVarint(u64& v)
+	{
+		return readLeb(v);
+	}
+
+	bool BinSerializer::writeVarint(u32 v)
+	{
+		return writeLeb(v);
+	}
+
+	bool BinSerializer::writeVarint(u64 v)
+	{
+		return writeLeb(v);
+	}
+
+	template <typename T>
+	bool BinSerializer::readLeb(T& v)
+	{
+		constexpr u32 maxBytes = (sizeof(T)*8 + 6) / 7;
+		const byte* p = pr_data() + m_ReadPos;
+		u32 avail = m_WritePos - m_ReadPos;
+		if ( avail != 0 && p[0] < 0x80 )
+		{
+			v = p[0];
+			m_ReadPos++;
+			return true;
+		}
+	#if MM_LIL_ENDIAN
+		if ( avail >= 8 )
+		{
+			// Decode up to 8 bytes at once. The first byte with a clear high bit ends the varint.
+			u64 w;
+			Platform::memCpy( &w, 8, p, 8 );
+			u64 ends = ~w & 0x8080808080808080ULL;
+			if ( ends )
+			{
+				u64 mask  = (((ends & (0-ends)) << 1) - 1);
+				u64 x	  = w & mask & 0x7F7F7F7F7F7F7F7FULL;
+				u32 len	  = (u32)(((mask & 0x0101010101010101ULL) * 0x0101010101010101ULL) >> 56);
+				u64 value = (x & 0x7FULL) | ((x>>1) & (0x7FULL<<7)) | ((x>>2) & (0x7FULL<<14)) | ((x>>3) & (0x7FULL<<21)) |
+							((x>>4) & (0x7FULL<<28)) | ((x>>5) & (0x7FULL<<35)) | ((x>>6) & (0x7FULL<<42)) | ((x>>7) & (0x7FULL<<49));
+				// A zero final byte is an overlong encoding, writeLeb never emits one.
+				if ( len > maxBytes || value > (u64)(T)-1 || (value >> (7*(len-1))) == 0 ) return false;
+				v = (T)value;
+				m_ReadPos += len;
+				return true;
+			}
+		}
+	#endif
+		u64 value = 0;
+		for ( u32 i = 0; i < maxBytes; ++i )
+		{
+			if ( m_ReadPos + i >= m_WritePos ) return false;
+			byte b = p[i];
+			// The last byte can only carry the bits left of T, more would be dropped by the shift.
+			if ( 7*i + 7 > sizeof(T)*8 && ((b & 0x7F) >> (sizeof(T)*8 - 7*i)) != 0 ) return false;
+			value |= (u64)(b & 0x7F) << (7*i);
+			if ( (b & 0x80) == 0 )
+			{
+				if ( value > (u64)(T)-1 || (i != 0 && b == 0) ) return false;
+				v = (T)value;
+				m_ReadPos += i+1;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename T>
+	bool BinSerializer::writeLeb(T v)
+	{
+		// 7 bits per byte, low bits first. The high bit is set if more bytes follow.
+		constexpr u32 maxBytes = (sizeof(T)*8 + 6) / 7;
+		if ( v < 0x80 )
+		{
+			return write8( (byte)v );
+		}
+		byte buff[maxBytes];
+		bool direct = m_MaxSize - m_WritePos >= maxBytes || grow( m_WritePos + maxBytes );
+		byte* p = direct ? pr_data() + m_WritePos : buff;
+		u32 n = 0;
+		while ( v >= 0x80 )
+		{
+			p[n++] = (byte)(v | 0x80);
+			v >>= 7;
+		}
+		p[n++] = (byte)v;
+		if ( !direct ) return write( buff, n );
+		m_WritePos += n;
+		return true;
+	}
+
 	u32 BinSerializer::getMaxSize() const
 	{
 		return m_MaxSize;
@@ -232,33 +370,114 @@ namespace MiepMiep
 		return m_DataPtr;
 	}
 
-	void BinSerializer::growTo(u32 requiredSize)
+	void BinSerializer::toNetworkOrder(byte* p, u32 elemSize, u32 count)
 	{
-		if (!m_Owns || requiredSize <= m_MaxSize) return;
-		m_MaxSize = u32(((requiredSize * 1.2f)/16) * 16 + 16);
-		assert(m_MaxSize > requiredSize);
-		byte* pNew = reserveN<byte>(MM_FL, m_MaxSize);
+	#if MM_LIL_ENDIAN
+		// Plain loops over whole words, so that the compiler vectorizes them.
+		switch ( elemSize )
+		{
+		case 2:
+			for ( u32 i=0; i<count; ++i )
+			{
+				u16 v; memcpy( &v, p + i*2, 2 );
+				v = (u16)((v >> 8) | (v << 8));
+				memcpy( p + i*2, &v, 2 );
+			}
+			break;
+		case 4:
+			for ( u32 i=0; i<count; ++i )
+			{
+				uint32_t v; memcpy( &v, p + i*4, 4 );
+				v = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+				memcpy( p + i*4, &v, 4 );
+			}
+			break;
+		case 8:
+			for ( u32 i=0; i<count; ++i )
+			{
+				uint64_t v; memcpy( &v, p + i*8, 8 );
+				v = ((v >> 56) & 0xFFULL) | ((v >> 40) & 0xFF00ULL) | ((v >> 24) & 0xFF0000ULL) | ((v >> 8) & 0xFF000000ULL) |
+					((v << 8) & 0xFF00000000ULL) | ((v << 24) & 0xFF0000000000ULL) | ((v << 40) & 0xFF000000000000ULL) | (v << 56);
+				memcpy( p + i*8, &v, 8 );
+			}
+			break;
+		}
+	#endif
+	}
+
+	bool BinSerializer::grow(u32 requiredSize)
+	{
+		// Buffers that are not ours cannot grow, shared buffers are copied.
+		if ( m_DataPtr != m_Inline && m_DataPtr != m_Heap && !m_Shared ) return false;
+		u32 newSize = Util::max( requiredSize, m_MaxSize*2 );
+		byte* pNew = reserveN<byte>(MM_FL, newSize);
 		Platform::copy(pNew, m_DataPtr, m_WritePos);
-		releaseN(m_DataPtr);
-		m_DataPtr = pNew;
+		releaseN(m_Heap);
+		m_Heap	   = pNew;
+		m_HeapSize = newSize;
+		m_DataPtr  = pNew;
+		m_MaxSize  = newSize;
+		m_Shared   = nullptr;
+		return true;
 	}
 
 
 	// -- Templates
 
-	template <typename T> bool BinSerializer::read(T& val)					{ return read(&val, sizeof(T)); }
+	// Zigzag maps signed to unsigned as 0, -1, 1, -2, 2.. so that small magnitudes give small varints.
+	template <typename U, typename S> static U zigzag(S v)		{ return ((U)v << 1) ^ (U)(v >> (sizeof(S)*8-1)); }
+	template <typename S, typename U> static S unzigzag(U v)	{ return (S)(v >> 1) ^ -(S)(v & 1); }
+
+	#define MM_VARINT ( m_IntEncoding == EIntEncoding::Varint )
+
 	template <> bool BinSerializer::read(bool& b)							{ return read8((byte&)b); }
 	template <> bool BinSerializer::read(byte& b)							{ return read8(b); }
-	template <> bool BinSerializer::read(u16& b)							{ return read16(b); }
-	template <> bool BinSerializer::read(u32& b)							{ return read32(b); }
-	template <> bool BinSerializer::read(u64& b)							{ return read64(b); }
+	template <> bool BinSerializer::read(u16& b)
+	{
+		if ( !MM_VARINT ) return read16(b);
+		u32 v;
+		if ( !readLeb(v) || v > 0xFFFF ) return false;
+		b = (u16)v;
+		return true;
+	}
+	template <> bool BinSerializer::read(u32& b)							{ return MM_VARINT ? readLeb(b) : read32(b); }
+	template <> bool BinSerializer::read(u64& b)							{ return MM_VARINT ? readLeb(b) : read64(b); }
 	template <> bool BinSerializer::read(char& b)							{ return read8((byte&)b); }
-	template <> bool BinSerializer::read(i16& b)							{ return read16((u16&)b); }
-	template <> bool BinSerializer::read(i32& b)							{ return read32((u32&)b); }
-	template <> bool BinSerializer::read(i64& b)							{ return read64((u64&)b); }
+	template <> bool BinSerializer::read(i16& b)
+	{
+		if ( !MM_VARINT ) return read16((u16&)b);
+		u16 v;
+		if ( !read(v) ) return false;
+		b = unzigzag<i16>(v);
+		return true;
+	}
+	template <> bool BinSerializer::read(i32& b)
+	{
+		if ( !MM_VARINT ) return read32((u32&)b);
+		u32 v;
+		if ( !readLeb(v) ) return false;
+		b = unzigzag<i32>(v);
+		return true;
+	}
+	template <> bool BinSerializer::read(i64& b)
+	{
+		if ( !MM_VARINT ) return read64((u64&)b);
+		u64 v;
+		if ( !readLeb(v) ) return false;
+		b = unzigzag<i64>(v);
+		return true;
+	}
 	template <> bool BinSerializer::read(float& b)							{ return read32(sc<u32&>(*rc<u32*>(&b))); }
 	template <> bool BinSerializer::read(double& b)							{ return read64(sc<u64&>(*rc<u64*>(&b))); }
-	template <> bool BinSerializer::read(BinSerializer& other)				{ return other.write(data(), length()); }
+	template <> bool BinSerializer::read(BinSerializer& other)
+	{
+		if ( m_Shared && other.length() == 0 )
+		{
+			other.view(m_Shared, data(), length());
+			return true;
+		}
+		return other.write(data(), length());
+	}
 	template <> bool BinSerializer::read(IAddress& b)						{ return b.read(*this); }
 	template <> bool BinSerializer::read(sptr<IAddress>& b)
 	{
@@ -286,7 +505,7 @@ namespace MiepMiep
 	template <> bool BinSerializer::read(MetaData& b) 
 	{ 
 		u32 mlen;
-		if (!read(mlen)) return false;
+		if (!readLeb(mlen)) return false;
 		std::string key, value;
 		for (u16 i=0; i<mlen; ++i)
 		{
@@ -297,16 +516,15 @@ namespace MiepMiep
 		return true;
 	}
 
-	template <typename T> bool BinSerializer::write(const T& val)			{ return write(&val, sizeof(T)); }
 	template <> bool BinSerializer::write(const bool& b)					{ return write8((byte)b); }
 	template <> bool BinSerializer::write(const byte& b)					{ return write8(b); }
-	template <> bool BinSerializer::write(const u16& b)						{ return write16(b); }
-	template <> bool BinSerializer::write(const u32& b)						{ return write32(b); }
-	template <> bool BinSerializer::write(const u64& b)						{ return write64(b); }
+	template <> bool BinSerializer::write(const u16& b)						{ return MM_VARINT ? writeLeb((u32)b) : write16(b); }
+	template <> bool BinSerializer::write(const u32& b)						{ return MM_VARINT ? writeLeb(b) : write32(b); }
+	template <> bool BinSerializer::write(const u64& b)						{ return MM_VARINT ? writeLeb(b) : write64(b); }
 	template <> bool BinSerializer::write(const char& b)					{ return write8(b); }
-	template <> bool BinSerializer::write(const i16& b)						{ return write16(b); }
-	template <> bool BinSerializer::write(const i32& b)						{ return write32(b); }
-	template <> bool BinSerializer::write(const i64& b)						{ return write64((i64&)b); }
+	template <> bool BinSerializer::write(const i16& b)						{ return MM_VARINT ? writeLeb((u32)zigzag<u16>(b)) : write16(b); }
+	template <> bool BinSerializer::write(const i32& b)						{ return MM_VARINT ? writeLeb(zigzag<u32>(b)) : write32(b); }
+	template <> bool BinSerializer::write(const i64& b)						{ return MM_VARINT ? writeLeb(zigzag<u64>(b)) : write64((i64&)b); }
 	template <> bool BinSerializer::write(const float& b)					{ return write32(sc<const u32&>(*rc<const u32*>(&b))); }
 	template <> bool BinSerializer::write(const double& b)					{ return write64(sc<const u64&>(*rc<const u64*>(&b))); }
 	template <> bool BinSerializer::write(const BinSerializer& other)		{ return write(other.data(), other.length()); }
@@ -327,7 +545,7 @@ namespace MiepMiep
 	template <> bool BinSerializer::write(const MetaData& b)
 	{
 		if ( b.size() > UINT32_MAX ) return false;
-		if ( !write<u32>((u32)b.size()) ) return false;
+		if ( !writeLeb((u32)b.size()) ) return false;
 		for ( auto& kvp : b ) 
 		{
 			if ( !write(kvp.first) )  return false;
@@ -335,4 +553,6 @@ namespace MiepMiep
 		}
 		return true;
 	}
+
+	#undef MM_VARINT
 }
\ No newline at end of file
@@ -1,11 +1,49 @@
 #pragma once
 
 #include "Types.h"
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 
 namespace MiepMiep
 {
 	constexpr u32 TempBuffSize = 4096;
+	constexpr u32 InlineBuffSize = 64;		// Messages up to this size do not allocate.
+	constexpr u32 KeepBuffSize = 64*1024;	// Larger buffers are released on reset.
+
+
+	/*	Fixed writes integers in network order at their full size. Varint writes them as LEB128, which takes 1 byte
+		for values below 128. Signed types are zigzag encoded first, so that small negative values are small too.
+		Both sides must use the same encoding. */
+	enum class EIntEncoding : byte
+	{
+		Fixed,
+		Varint
+	};
+
+	// Always serialized as varint, regardless of the encoding of the serializer. Use as rpc or var group argument.
+	template <typename T>
+	struct VarInt
+	{
+		VarInt(T v=T()): m_Value(v) { }
+		operator T() const { return m_Value; }
+		T m_Value;
+	};
+
+	/*	Types without a read/write specialization that are trivially copyable are copied as they are in memory, so both
+		sides must have the same layout and endianness. Arrays of them are copied in bulk. Specialize as false_type for
+		types that must go through their readOrWrite. */
+	template <typename T>
+	struct IsBulkCopyable: std::integral_constant<bool, std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value> { };
+	template <typename T>
+	struct IsBulkCopyable<VarInt<T>>: std::false_type { };
+
+	class BinSerializer;
+	// Serializes 't' through its read/write specialization if it has one. Specialize for own types, see the example below.
+	template <typename T>
+	inline bool readOrWrite( BinSerializer& bs, T& t, bool _write );
 
 
 	class MM_DECLSPEC BinSerializer
@@ -19,8 +57,14 @@ namespace MiepMiep
 		BinSerializer& operator=(BinSerializer&& other) noexcept;
 		~BinSerializer();
 
+		// Empties the serializer but keeps its buffer for reuse.
 		void reset();
 		void resetTo(const byte* streamIn, u32 buffSize, u32 writePos, bool copyData=false, bool ownsData=false);
+		// Ensures that 'size' bytes fit without reallocating. Fails for buffers that are not owned.
+		bool reserve(u32 size);
+		// Reads 'data' without copying it, keeping 'owner' alive. Copies of the serializer share it too.
+		// Writing copies the data first.
+		void view(const sptr<const byte>& owner, const byte* data, u32 length);
 		void copyAsRaw(byte*& ptr, u32& len);
 
 		bool setRead(u32 r);
@@ -29,6 +73,15 @@ namespace MiepMiep
 		bool moveWrite(u32 w);
 		bool read(byte* b, u32 buffSize);
 		bool write(const byte* b, u32 buffSize);
+		// LEB128, 1 to 5 (10 for 64 bits) bytes depending on the magnitude.
+		bool readVarint(u32& v);
+		bool readVarint(u64& v);
+		bool writeVarint(u32 v);
+		bool writeVarint(u64 v);
+
+		// Applies to all integers wider than a byte written or read after this. Default is Fixed.
+		void setIntEncoding(EIntEncoding encoding) { m_IntEncoding = encoding; }
+		EIntEncoding getIntEncoding() const		   { return m_IntEncoding; }
 
 		// --- Getters ----
 
@@ -40,7 +93,7 @@ namespace MiepMiep
 
 		// --- Templates ----
 
-		template <typename T> bool write(const T& val);
+		template <typename T> bool write(const T& val)		{ return writeBulk( &val, 1 ); }
 		template <> bool write(const bool& b);
 		template <> bool write(const byte& b);
 		template <> bool write(const u16& b);
@@ -59,7 +112,7 @@ namespace MiepMiep
 		template <> bool write(const std::string& b);
 		template <> bool write(const MetaData& b);
 		
-		template <typename T> bool read(T& val);
+		template <typename T> bool read(T& val)				{ return readBulk( &val, 1 ); }
 		template <> bool read(bool& b);
 		template <> bool read(byte& b);
 		template <> bool read(u16& b);
@@ -77,6 +130,51 @@ namespace MiepMiep
 		template <> bool read(std::string& b);
 		template <> bool read(MetaData& b);
 
+		template <typename T> bool write(const VarInt<T>& val)		{ return withVarint( [&] { return write( val.m_Value ); } ); }
+		template <typename T> bool read(VarInt<T>& val)				{ return withVarint( [&] { return read( val.m_Value ); } ); }
+
+		// Count as varint, followed by the elements.
+		template <typename T, typename A> bool write(const std::vector<T, A>& v)
+		{
+			if ( v.size() > ~(u32)0 || !writeVarint( (u32)v.size() ) ) return false;
+			return writeElements( v.data(), (u32)v.size(), IsBulkCopyable<T>() );
+		}
+		template <typename T, typename A> bool read(std::vector<T, A>& v)
+		{
+			u32 count;
+			if ( !readVarint( count ) ) return false;
+			if ( count > m_WritePos - m_ReadPos ) return false; // Each element takes at least a byte, reject before allocating.
+			v.resize( count );
+			return readElements( v.data(), count, IsBulkCopyable<T>() );
+		}
+
+		template <typename T, size_t N> bool write(const std::array<T, N>& a)	{ return writeElements( a.data(), (u32)N, IsBulkCopyable<T>() ); }
+		template <typename T, size_t N> bool read(std::array<T, N>& a)			{ return readElements( a.data(), (u32)N, IsBulkCopyable<T>() ); }
+
+		// One bounds check and one copy for all elements. Scalars are converted to network order.
+		template <typename T> bool writeBulk(const T* p, u32 count)
+		{
+			static_assert( IsBulkCopyable<T>::value, "Type has no read/write specialization and is not trivially copyable." );
+			u64 size = (u64)sizeof(T) * count;
+			if ( size > (u64)(u32)-1 - m_WritePos ) return false;
+			u32 newWrite = m_WritePos + (u32)size;
+			if ( newWrite > m_MaxSize && !grow(newWrite) ) return false;
+			std::memcpy( m_DataPtr + m_WritePos, p, (size_t)size );
+			if ( std::is_arithmetic<T>::value ) toNetworkOrder( m_DataPtr + m_WritePos, sizeof(T), count );
+			m_WritePos = newWrite;
+			return true;
+		}
+		template <typename T> bool readBulk(T* p, u32 count)
+		{
+			static_assert( IsBulkCopyable<T>::value, "Type has no read/write specialization and is not trivially copyable." );
+			u64 size = (u64)sizeof(T) * count;
+			if ( size > m_WritePos - m_ReadPos ) return false;
+			std::memcpy( p, m_DataPtr + m_ReadPos, (size_t)size );
+			if ( std::is_arithmetic<T>::value ) toNetworkOrder( reinterpret_cast<byte*>(p), sizeof(T), count );
+			m_ReadPos += (u32)size;
+			return true;
+		}
+
 		template <typename T> bool readOrWrite( T& t, bool _write )
 		{
 			return _write?this->typename write(t):this->typename read(t);
@@ -91,15 +189,62 @@ namespace MiepMiep
 		bool read16(u16& b);
 		bool read32(u32& b);
 		bool read64(u64& b);
+		template <typename T> bool readLeb(T& v);
+		template <typename T> bool writeLeb(T v);
+		// Swaps each element in place on little endian hosts.
+		static void toNetworkOrder(byte* p, u32 elemSize, u32 count);
+
+		template <typename F> bool withVarint( const F& f )
+		{
+			EIntEncoding old = m_IntEncoding;
+			m_IntEncoding = EIntEncoding::Varint;
+			bool res = f();
+			m_IntEncoding = old;
+			return res;
+		}
+
+		// Integers that are varint encoded differ in size per element, so they cannot be copied in bulk.
+		template <typename T> bool varintElements() const { return std::is_integral<T>::value && sizeof(T) > 1 && m_IntEncoding == EIntEncoding::Varint; }
+
+		template <typename T> bool writeElements(const T* p, u32 count, std::true_type)
+		{
+			if ( !varintElements<T>() ) return writeBulk( p, count );
+			return writeElements( p, count, std::false_type() );
+		}
+		template <typename T> bool writeElements(const T* p, u32 count, std::false_type)
+		{
+			for ( u32 i=0; i<count; ++i )
+			{
+				if ( !MiepMiep::readOrWrite( *this, const_cast<T&>(p[i]), true ) ) return false;
+			}
+			return true;
+		}
+		template <typename T> bool readElements(T* p, u32 count, std::true_type)
+		{
+			if ( !varintElements<T>() ) return readBulk( p, count );
+			return readElements( p, count, std::false_type() );
+		}
+		template <typename T> bool readElements(T* p, u32 count, std::false_type)
+		{
+			for ( u32 i=0; i<count; ++i )
+			{
+				if ( !MiepMiep::readOrWrite( *this, p[i], false ) ) return false;
+			}
+			return true;
+		}
 		byte* pr_data() const;
-		void growTo(u32 maxSize);
+		bool grow(u32 requiredSize);
 
 	private:
-		byte* m_DataPtr;
+		byte* m_DataPtr;	// Points to the inline buffer, the heap buffer or a buffer that is not owned.
+		byte* m_Heap;
+		u32   m_HeapSize;
 		u32   m_WritePos;
 		u32   m_ReadPos;
 		u32   m_MaxSize;
-		bool  m_Owns;
+		EIntEncoding m_IntEncoding;
+		sptr<const byte> m_Shared;	// Set if viewing shared bytes.
+		byte  m_Inline[InlineBuffSize];
 	};
 
 
@@ -112,6 +257,7 @@ namespace MiepMiep
 
 
 // Example adding own read/write to binSerializer.
+// This is only needed for types that are not trivially copyable, such as this one due to the string.
 
 /*
 
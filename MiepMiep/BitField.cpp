@@ -1,7 +0,0 @@
-#include "BitField.h"
-
-
-namespace MiepMiep
-{
-
-}
\ No newline at end of file
@@ -1,11 +0,0 @@
-#pragma once
-
-#include "Variable.h"
-
-
-namespace MiepMiep
-{
-	class BitField: public IVariable
-	{
-	};
-}
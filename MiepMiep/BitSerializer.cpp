@@ -0,0 +1,162 @@
+#include "BitSerializer.h"
+#include "Util.h"
+#include <cassert>
+#include <cmath>
+
+
+namespace MiepMiep
+{
+	// Components other than the largest of a normalized quaternion lie within [-1/sqrt(2), 1/sqrt(2)].
+	constexpr float QuatComponentMax = 0.70710678f;
+
+
+	// ------------ BitSerializer ------------------------------------------------------------------------------
+
+	BitSerializer::BitSerializer(BinSerializer& bs, bool write):
+		m_Bs(bs),
+		m_Scratch(0),
+		m_NumBits(0),
+		m_Write(write)
+	{
+	}
+
+	bool BitSerializer::flush()
+	{
+		if ( m_Write )
+		{
+			while ( m_NumBits > 0 )
+			{
+				if ( !m_Bs.write( (byte)m_Scratch ) ) return false;
+				m_Scratch >>= 8;
+				m_NumBits = m_NumBits > 8 ? m_NumBits-8 : 0;
+			}
+		}
+		m_Scratch = 0;
+		m_NumBits = 0;
+		return true;
+	}
+
+	bool BitSerializer::writeBits(u32 value, u32 numBits)
+	{
+		assert( m_Write && numBits >= 1 && numBits <= 32 );
+		m_Scratch |= ((u64)value & ((1ULL << numBits) - 1)) << m_NumBits;
+		m_NumBits += numBits;
+		if ( m_NumBits >= 32 )
+		{
+			// Move out 4 bytes at once.
+			byte out[4] = { (byte)m_Scratch, (byte)(m_Scratch>>8), (byte)(m_Scratch>>16), (byte)(m_Scratch>>24) };
+			if ( !m_Bs.write( out, 4 ) ) return false;
+			m_Scratch >>= 32;
+			m_NumBits -= 32;
+		}
+		return true;
+	}
+
+	bool BitSerializer::readBits(u32& value, u32 numBits)
+	{
+		assert( !m_Write && numBits >= 1 && numBits <= 32 );
+		while ( m_NumBits < numBits )
+		{
+			byte b;
+			if ( !m_Bs.read( b ) ) return false;
+			m_Scratch |= (u64)b << m_NumBits;
+			m_NumBits += 8;
+		}
+		value = (u32)(m_Scratch & ((1ULL << numBits) - 1));
+		m_Scratch >>= numBits;
+		m_NumBits -= numBits;
+		return true;
+	}
+
+	bool BitSerializer::writeInt(i32 value, i32 min, i32 max)
+	{
+		assert( min < max );
+		value = Util::min( Util::max( value, min ), max );
+		return writeBits( (u32)(value - min), bitsRequired( (u32)(max - min) ) );
+	}
+
+	bool BitSerializer::readInt(i32& value, i32 min, i32 max)
+	{
+		assert( min < max );
+		u32 v;
+		if ( !readBits( v, bitsRequired( (u32)(max - min) ) ) ) return false;
+		value = Util::min( (i32)(min + v), max );
+		return true;
+	}
+
+	bool BitSerializer::writeFloat(float value, float min, float max, u32 numBits)
+	{
+		assert( min < max );
+		double maxQ = (double)((1ULL << numBits) - 1);
+		double t = ((double)value - min) / ((double)max - min);
+		t = Util::min( Util::max( t, 0.0 ), 1.0 ); // Also maps NaN to 0.
+		return writeBits( (u32)(t * maxQ + 0.5), numBits );
+	}
+
+	bool BitSerializer::readFloat(float& value, float min, float max, u32 numBits)
+	{
+		assert( min < max );
+		u32 q;
+		if ( !readBits( q, numBits ) ) return false;
+		double maxQ = (double)((1ULL << numBits) - 1);
+		value = (float)(min + ((double)max - min) * (q / maxQ));
+		return true;
+	}
+
+	bool BitSerializer::writeVec3(const Vec3& value, float min, float max, u32 numBits)
+	{
+		return writeFloat( value.x, min, max, numBits ) &&
+			   writeFloat( value.y, min, max, numBits ) &&
+			   writeFloat( value.z, min, max, numBits );
+	}
+
+	bool BitSerializer::readVec3(Vec3& value, float min, float max, u32 numBits)
+	{
+		return readFloat( value.x, min, max, numBits ) &&
+			   readFloat( value.y, min, max, numBits ) &&
+			   readFloat( value.z, min, max, numBits );
+	}
+
+	bool BitSerializer::writeQuat(const Quat& value, u32 numBits)
+	{
+		float c[4] = { value.x, value.y, value.z, value.w };
+		u32 largest = 0;
+		for ( u32 i=1; i<4; ++i )
+		{
+			if ( fabsf( c[i] ) > fabsf( c[largest] ) ) largest = i;
+		}
+		// q and -q are the same rotation, flip so that the omitted component is positive.
+		float sign = c[largest] < 0 ? -1.f : 1.f;
+		if ( !writeBits( largest, 2 ) ) return false;
+		for ( u32 i=0; i<4; ++i )
+		{
+			if ( i == largest ) continue;
+			if ( !writeFloat( c[i]*sign, -QuatComponentMax, QuatComponentMax, numBits ) ) return false;
+		}
+		return true;
+	}
+
+	bool BitSerializer::readQuat(Quat& value, u32 numBits)
+	{
+		u32 largest;
+		if ( !readBits( largest, 2 ) ) return false;
+		float c[4];
+		float sumSq = 0;
+		for ( u32 i=0; i<4; ++i )
+		{
+			if ( i == largest ) continue;
+			if ( !readFloat( c[i], -QuatComponentMax, QuatComponentMax, numBits ) ) return false;
+			sumSq += c[i]*c[i];
+		}
+		c[largest] = sqrtf( Util::max( 1.f - sumSq, 0.f ) );
+		value = { c[0], c[1], c[2], c[3] };
+		return true;
+	}
+
+	u32 BitSerializer::bitsRequired(u32 maxValue)
+	{
+		u32 bits = 1;
+		while ( bits < 32 && (maxValue >> bits) != 0 ) bits++;
+		return bits;
+	}
+}
\ No newline at end of file
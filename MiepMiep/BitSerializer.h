@@ -0,0 +1,142 @@
+#pragma once
+
+#include "BinSerializer.h"
+#include "Variables.h"
+
+
+namespace MiepMiep
+{
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	struct Quat
+	{
+		float x, y, z, w;
+	};
+
+	struct Transform
+	{
+		Vec3 m_Position;
+		Quat m_Rotation;
+	};
+
+
+	/*	Packs values at bit granularity on top of a BinSerializer. Bits are appended to, or consumed from, the serializer
+		in whole bytes, so the stream must be flushed before the BinSerializer is used directly again.
+		Quantized values lose precision: a float of n bits over [min, max] is accurate to (max-min) / (2^n - 1). */
+	class MM_DECLSPEC BitSerializer
+	{
+	public:
+		BitSerializer(BinSerializer& bs, bool write);
+
+		// Writing appends the pending bits padded to a byte. Reading skips the rest of the current byte.
+		bool flush();
+
+		// 1 to 32 bits.
+		bool writeBits(u32 value, u32 numBits);
+		bool readBits(u32& value, u32 numBits);
+
+		// Clamped to [min, max].
+		bool writeInt(i32 value, i32 min, i32 max);
+		bool readInt(i32& value, i32 min, i32 max);
+		bool writeFloat(float value, float min, float max, u32 numBits);
+		bool readFloat(float& value, float min, float max, u32 numBits);
+		bool writeVec3(const Vec3& value, float min, float max, u32 numBits);
+		bool readVec3(Vec3& value, float min, float max, u32 numBits);
+
+		// Smallest three: the index of the largest component in 2 bits, followed by the other three at 'numBits' each.
+		// The quaternion must be normalized.
+		bool writeQuat(const Quat& value, u32 numBits);
+		bool readQuat(Quat& value, u32 numBits);
+
+		bool readOrWriteBits( u32& value, u32 numBits )									{ return m_Write ? writeBits( value, numBits ) : readBits( value, numBits ); }
+		bool readOrWriteInt( i32& value, i32 min, i32 max )								{ return m_Write ? writeInt( value, min, max ) : readInt( value, min, max ); }
+		bool readOrWriteFloat( float& value, float min, float max, u32 numBits )		{ return m_Write ? writeFloat( value, min, max, numBits ) : readFloat( value, min, max, numBits ); }
+		bool readOrWriteVec3( Vec3& value, float min, float max, u32 numBits )			{ return m_Write ? writeVec3( value, min, max, numBits ) : readVec3( value, min, max, numBits ); }
+		bool readOrWriteQuat( Quat& value, u32 numBits )								{ return m_Write ? writeQuat( value, numBits ) : readQuat( value, numBits ); }
+
+		static u32 bitsRequired(u32 maxValue);
+
+	private:
+		BinSerializer& m_Bs;
+		u64  m_Scratch;		// Pending bits, the oldest in the lowest bits.
+		u32  m_NumBits;
+		bool m_Write;
+	};
+
+
+	// ---- Precisions, used as the second argument of Quantized -----------------------------------
+
+	template <i32 Min, i32 Max>
+	struct IntPrecision
+	{
+		static bool readOrWrite( BitSerializer& bs, i32& v ) { return bs.readOrWriteInt( v, Min, Max ); }
+	};
+
+	template <i32 Min, i32 Max, u32 Bits>
+	struct FloatPrecision
+	{
+		static bool readOrWrite( BitSerializer& bs, float& v ) { return bs.readOrWriteFloat( v, (float)Min, (float)Max, Bits ); }
+	};
+
+	template <i32 Min, i32 Max, u32 Bits>
+	struct Vec3Precision
+	{
+		static bool readOrWrite( BitSerializer& bs, Vec3& v ) { return bs.readOrWriteVec3( v, (float)Min, (float)Max, Bits ); }
+	};
+
+	template <u32 Bits>
+	struct QuatPrecision
+	{
+		static bool readOrWrite( BitSerializer& bs, Quat& v ) { return bs.readOrWriteQuat( v, Bits ); }
+	};
+
+	template <i32 Min, i32 Max, u32 PosBits, u32 RotBits>
+	struct TransformPrecision
+	{
+		static bool readOrWrite( BitSerializer& bs, Transform& v )
+		{
+			return bs.readOrWriteVec3( v.m_Position, (float)Min, (float)Max, PosBits ) && bs.readOrWriteQuat( v.m_Rotation, RotBits );
+		}
+	};
+
+
+	/*	Tag to synchronize a T bit packed with the given precision, eg. GenericNetVar<Quantized<float, FloatPrecision<0, 100, 10>>>.
+		Each variable is padded to a whole byte. */
+	template <typename T, typename Precision>
+	struct Quantized { };
+
+	template <typename T, typename Precision>
+	class GenericNetVar<Quantized<T, Precision>>: public GenericNetVar<T>
+	{
+	public:
+		using GenericNetVar<T>::GenericNetVar;
+		using GenericNetVar<T>::operator=;
+
+		bool readOrWrite( BinSerializer& bs, bool write ) override
+		{
+			BitSerializer bits( bs, write );
+			return Precision::readOrWrite( bits, this->m_Data ) && bits.flush();
+		}
+	};
+
+
+	template <i32 Min, i32 Max>
+	using NetQInt = GenericNetVar<Quantized<i32, IntPrecision<Min, Max>>>;
+
+	template <i32 Min, i32 Max, u32 Bits>
+	using NetQFloat = GenericNetVar<Quantized<float, FloatPrecision<Min, Max, Bits>>>;
+
+	template <i32 Min, i32 Max, u32 Bits>
+	using NetQVec3 = GenericNetVar<Quantized<Vec3, Vec3Precision<Min, Max, Bits>>>;
+
+	template <u32 Bits>
+	using NetQQuat = GenericNetVar<Quantized<Quat, QuatPrecision<Bits>>>;
+
+	// With a range of 1024 and 14 bits per coordinate (6 cm), and 9 bits per rotation component, a transform takes
+	// 42 + 29 bits = 9 bytes instead of 28.
+	template <i32 Min, i32 Max, u32 PosBits, u32 RotBits>
+	using NetQTransform = GenericNetVar<Quantized<Transform, TransformPrecision<Min, Max, PosBits, RotBits>>>;
+}
\ No newline at end of file
@@ -29,19 +29,86 @@ using namespace std;
 #define MM_RELAY_BIT 4
 #define MM_FRAGMENT_FIRST_BIT 8
 #define MM_FRAGMENT_LAST_BIT 16
+#define MM_FRAGMENT_INFO_SIZE 8					/* totalLength(4) + numFragments(4), in the first fragment of a fragmented message */
+#define MM_MAX_MESSAGE_SIZE (1<<28)				/* Fragmented messages that claim to be larger are dropped */
 #define MM_SYSTEM_BIT 32
+#define MM_UNORDERED_BIT 64
+#define MM_COMPRESSED_BIT 128
 #define MM_NUM_CHANNELS 8
+#define MM_RELIABLE_SEND_WINDOW 256				/* Initial number of unacked packets per channel, grows by doubling */
+#define MM_MAX_RELIABLE_SEND_WINDOW (1<<20)		/* Use INetwork::setSendQueueLimits to bound the queue well before this */
+#define MM_RELIABLE_RECV_WINDOW 1024			/* Packets per channel held for reordering, newer packets are dropped */
+#define MM_MAX_UNRELIABLE_QUEUE 64				/* Unreliable packets per channel waiting to be sent, the oldest is dropped */
 
 /* (Re)send thread */
 #define MM_ST_LINKS_CLUSTER_SIZE 64
 #define MM_ST_RESEND_CHECK_INTERVAL 4 /* ms */
 
+/* Send scheduler */
+#define MM_SCHEDULER_QUANTUM MM_MAX_PLPMTU	/* Bytes added to a channel's deficit per round, multiplied by its weight */
+#define MM_SCHEDULER_BURST_TIME 20			/* ms, a rate limited link can send at most this much time worth of data at once */
+
 /* Receive thread */
 #define MM_SOCK_SELECT_TIMEOUT 60 /* ms */
 
 /* Congestion control & stats */
-#define MM_MIN_RESEND_LATENCY_MP 1.3f
-#define MM_MAX_RESEND_LATENCY_MP 10.f
+#define MM_RELIABLE_LINK_HDR_SIZE 8		/* seq(4) + timestamp(4), written per link on each (re)send of a reliable packet */
+#define MM_UNRELIABLE_LINK_HDR_SIZE 4	/* seq(4), written per link on send of an unreliable packet */
+#define MM_RELIABLE_NEW_LINK_HDR_SIZE 8	/* version(4) + key(4), written per link on each (re)send of a reliable newest packet */
+#define MM_INITIAL_RTT 33				/* ms, assumed round trip time until the first sample arrives */
+#define MM_RTT_GRANULARITY MM_ST_RESEND_CHECK_INTERVAL
+#define MM_MIN_RTO 20					/* ms */
+#define MM_MAX_RTO 2000					/* ms */
+#define MM_MAX_RTO_BACKOFF 5			/* RTO is at most doubled this many times on consecutive timeouts */
+#define MM_MIN_ACK_AGGREGATE_TIME 2		/* ms */
+#define MM_MAX_ACK_AGGREGATE_TIME 25	/* ms */
+#define MM_INVALID_ACK_DELAY 0xFFFF		/* Ack packet carries no timestamp echo */
+#define MM_MAX_ACK_DELAY (MM_INVALID_ACK_DELAY-1)
+
+/* Path mtu discovery (DPLPMTUD, RFC 8899). Sizes are udp payload sizes. */
+#define MM_BASE_PLPMTU 1200				/* Assumed to work on any path, used until a probe confirms a larger size */
+#define MM_MAX_PLPMTU MM_MAX_FRAGMENTSIZE
+#define MM_COMMON_PLPMTU_IPV4 1472		/* Ethernet 1500 - ip(20) - udp(8), probed first as most paths support it */
+#define MM_COMMON_PLPMTU_IPV6 1452		/* Ethernet 1500 - ip(40) - udp(8) */
+#define MM_PMTU_MAX_PROBES 3			/* Consecutive lost probes before a size is considered too big */
+#define MM_PMTU_SEARCH_ACCURACY 8		/* Search stops when the gap between confirmed and failed size is smaller */
+#define MM_PMTU_RAISE_TIMER 600000		/* ms, after which a completed search tries to find a larger mtu again */
+
+/* Forward error correction of reliable packets, see FecSend. */
+#define MM_FEC_PARITY_OVERHEAD 4		/* Reliable packets on a fec channel are this much smaller, so parity packets fit the mtu */
+#define MM_FEC_MIN_LOSS 0.002f			/* No parity is sent below this loss rate */
+#define MM_FEC_XOR_TARGET_LOSS 0.1f		/* Xor group size is chosen such that on average this many packets per group are lost */
+#define MM_FEC_MIN_GROUP 4
+#define MM_FEC_MAX_GROUP 32
+#define MM_FEC_RS_GROUP 16
+#define MM_FEC_RS_REDUNDANCY 3.f		/* Reed-Solomon parity packets per expected lost packet in a group */
+#define MM_FEC_MAX_PARITY 8
+#define MM_FEC_GROUP_TIMEOUT 10			/* ms, an incomplete group is closed and protected after this time */
+#define MM_FEC_RECV_HISTORY 256			/* Received packets per channel kept to recover lost packets from */
+#define MM_LOSS_SAMPLE_PACKETS 64		/* Sent packets per loss rate sample */
+
+/* Streams, see INetwork::sendStream. */
+#define MM_STREAM_WINDOW 64				/* Unacked reliable packets on the channel, above which a stream pauses */
+#define MM_STREAM_CHUNK_HDR_SIZE 8		/* compType(1) + channelAndFlags(1) + dataId(1) + streamId(4) + isLast(1) */
+
+/* Payload compression, see Lz. */
+#define MM_LZ_HASH_BITS 12
+#define MM_LZ_MIN_MATCH 4
+#define MM_LZ_MAX_OFFSET 65535
+#define MM_COMPRESSION_MIN_SIZE 32		/* Smaller messages are not compressed */
+#define MM_COMPRESSION_MIN_GAIN 8		/* Bytes a message must shrink, otherwise it is sent uncompressed */
+#define MM_COMPRESSION_NO_DICT_ID 1		/* Announced when compression is enabled without dictionary */
+#define MM_MAX_DECOMPRESSED_SIZE (1<<24)
+#define MM_MAX_RPC_IDS (1<<16)			/* Remote rpc ids beyond this are rejected, bounds the per link table. */
+#define MM_INVALID_RPC_ID ((u32)-1)
+
+/* Job system, see JobSystem. */
+#define MM_JOB_DEQUE_SIZE 4096			/* Jobs a worker holds in its own deque, more go to the injection queue */
+#define MM_JOB_INJECT_SIZE 8192			/* Jobs from other threads that can be queued without taking a lock */
+#define MM_JOB_SPIN_ROUNDS 32			/* Rounds an idle worker tries to steal before it goes to sleep */
+#define MM_JOB_FUNC_SIZE 40				/* Bytes a job can capture, so that a job node fits in one cache line */
+#define MM_JOB_POOL_CHUNK 256			/* Job nodes the pool allocates at once, also the most a worker keeps for itself */
+#define MM_STRAND_BATCH 64				/* Callbacks a strand runs before it yields to other jobs */
 
 /*	At what number create new server list */
 #define MM_NEW_SERVER_LIST_THRESHOLD 1000
@@ -38,7 +38,16 @@ namespace MiepMiep
 		ReliableAckSend,
 		ReliableAckRecv,
 		ReliableNewAckSend,
-		ReliableNewAckRecv
+		ReliableNewAckRecv,
+		// other link components
+		MtuDiscovery,
+		SendScheduler,
+		FecSend,
+		FecRecv,
+		LinkCompression,
+		StreamSend,
+		StreamRecv,
+		RpcIdTable
 	};
 
 
@@ -0,0 +1,148 @@
+#include "Fec.h"
+#include "Platform.h"
+#include <cstring>
+
+
+namespace MiepMiep
+{
+	// GF(256) with polynomial x^8+x^4+x^3+x^2+1 (0x11D) and generator 2.
+	struct GaloisTables
+	{
+		byte m_Exp[512];
+		byte m_Log[256];
+
+		GaloisTables()
+		{
+			u32 x = 1;
+			for ( u32 i=0; i<255; ++i )
+			{
+				m_Exp[i] = (byte)x;
+				m_Log[x] = (byte)i;
+				x <<= 1;
+				if ( x & 0x100 ) x ^= 0x11D;
+			}
+			for ( u32 i=255; i<512; ++i )
+			{
+				m_Exp[i] = m_Exp[i-255];
+			}
+			m_Log[0] = 0; // Undefined, never used.
+		}
+	};
+
+	static const GaloisTables s_GF;
+
+
+	byte Fec::mul( byte a, byte b )
+	{
+		if ( a == 0 || b == 0 ) return 0;
+		return s_GF.m_Exp[ s_GF.m_Log[a] + s_GF.m_Log[b] ];
+	}
+
+	byte Fec::inv( byte a )
+	{
+		assert( a != 0 );
+		return s_GF.m_Exp[ 255 - s_GF.m_Log[a] ];
+	}
+
+	void Fec::mulAdd( byte* dst, const byte* src, byte c, u32 length )
+	{
+		if ( c == 0 )
+			return;
+		if ( c == 1 )
+		{
+			for ( u32 i=0; i<length; ++i ) dst[i] ^= src[i];
+			return;
+		}
+		u32 logC = s_GF.m_Log[c];
+		for ( u32 i=0; i<length; ++i )
+		{
+			if ( src[i] != 0 ) dst[i] ^= s_GF.m_Exp[ logC + s_GF.m_Log[src[i]] ];
+		}
+	}
+
+	byte Fec::coef( EFecMode mode, u32 parityIdx, u32 sourceIdx, u32 k )
+	{
+		if ( mode == EFecMode::Xor )
+			return 1;
+		// Cauchy matrix 1/(x_j + y_i) with x_j = k+j and y_i = i, every square submatrix is invertible.
+		return inv( (byte)((k + parityIdx) ^ sourceIdx) );
+	}
+
+	void Fec::encode( EFecMode mode, const byte* const* sources, u32 k, byte* const* parity, u32 m, u32 length )
+	{
+		assert( k + m <= 256 && (mode != EFecMode::Xor || m == 1) );
+		for ( u32 j=0; j<m; ++j )
+		{
+			memset( parity[j], 0, length );
+			for ( u32 i=0; i<k; ++i )
+			{
+				mulAdd( parity[j], sources[i], coef( mode, j, i, k ), length );
+			}
+		}
+	}
+
+	bool Fec::decode( EFecMode mode, byte* const* sources, const bool* sourcePresent, u32 k, const byte* const* parity, u32 m, u32 length )
+	{
+		vector<u32> missing;
+		vector<u32> usedParity;
+		for ( u32 i=0; i<k; ++i )
+		{
+			if ( !sourcePresent[i] ) missing.emplace_back( i );
+		}
+		for ( u32 j=0; j<m && usedParity.size() < missing.size(); ++j )
+		{
+			if ( parity[j] ) usedParity.emplace_back( j );
+		}
+		if ( usedParity.size() < missing.size() )
+			return false;
+		u32 n = (u32)missing.size();
+		if ( n == 0 )
+			return true;
+
+		// Right hand side: parity minus the contribution of the sources that are present.
+		vector<vector<byte>> rhs( n );
+		vector<vector<byte>> mat( n, vector<byte>( n ) );
+		for ( u32 r=0; r<n; ++r )
+		{
+			u32 j = usedParity[r];
+			rhs[r].assign( parity[j], parity[j] + length );
+			for ( u32 i=0; i<k; ++i )
+			{
+				if ( sourcePresent[i] ) mulAdd( rhs[r].data(), sources[i], coef( mode, j, i, k ), length );
+			}
+			for ( u32 c=0; c<n; ++c )
+			{
+				mat[r][c] = coef( mode, j, missing[c], k );
+			}
+		}
+
+		// Gauss-Jordan elimination, in GF(256) addition and subtraction are both xor.
+		for ( u32 c=0; c<n; ++c )
+		{
+			u32 pivot = c;
+			while ( pivot < n && mat[pivot][c] == 0 ) pivot++;
+			if ( pivot == n )
+				return false;
+			swap( mat[c], mat[pivot] );
+			swap( rhs[c], rhs[pivot] );
+			byte pivotInv = inv( mat[c][c] );
+			for ( u32 cc=0; cc<n; ++cc ) mat[c][cc] = mul( mat[c][cc], pivotInv );
+			vector<byte> scaled( length, 0 );
+			mulAdd( scaled.data(), rhs[c].data(), pivotInv, length );
+			rhs[c].swap( scaled );
+			for ( u32 r=0; r<n; ++r )
+			{
+				byte f = mat[r][c];
+				if ( r == c || f == 0 ) continue;
+				for ( u32 cc=0; cc<n; ++cc ) mat[r][cc] ^= mul( f, mat[c][cc] );
+				mulAdd( rhs[r].data(), rhs[c].data(), f, length );
+			}
+		}
+
+		for ( u32 r=0; r<n; ++r )
+		{
+			Platform::memCpy( sources[missing[r]], length, rhs[r].data(), length );
+		}
+		return true;
+	}
+}
\ No newline at end of file
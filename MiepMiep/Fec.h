@@ -0,0 +1,28 @@
+#pragma once
+
+#include "MiepMiep.h"
+#include <vector>
+
+
+namespace MiepMiep
+{
+	/*
+		Erasure codes over symbols of equal length. A group of 'k' source symbols is protected by 'm' parity symbols.
+		Xor: A single parity symbol which is the xor of all sources, recovers one lost source.
+		ReedSolomon: Systematic code over GF(256) with a Cauchy matrix, any 'm' lost symbols can be recovered. k+m <= 256.
+	*/
+	struct Fec
+	{
+		static void encode( EFecMode mode, const byte* const* sources, u32 k, byte* const* parity, u32 m, u32 length );
+
+		// Missing entries in 'sources' must point to a buffer of 'length' bytes, they receive the recovered symbol on succes.
+		// Missing parity symbols are nullptr. Returns false if too many symbols are missing.
+		static bool decode( EFecMode mode, byte* const* sources, const bool* sourcePresent, u32 k, const byte* const* parity, u32 m, u32 length );
+
+	private:
+		static byte coef( EFecMode mode, u32 parityIdx, u32 sourceIdx, u32 k );
+		static byte mul( byte a, byte b );
+		static byte inv( byte a );
+		static void mulAdd( byte* dst, const byte* src, byte c, u32 length ); // dst += c*src
+	};
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "FecRecv.h"
+#include "Fec.h"
+#include "Link.h"
+#include "PacketHelper.h"
+#include "Util.h"
+
+
+namespace MiepMiep
+{
+	FecRecv::FecRecv(Link& link):
+		ParentLink(link),
+		m_Symbols(MM_FEC_RECV_HISTORY, MM_FEC_RECV_HISTORY)
+	{
+	}
+
+	MM_TS void FecRecv::addSource( u32 seq, const byte* data, u32 length )
+	{
+		if ( length < MM_RELIABLE_LINK_HDR_SIZE + 2 )
+			return;
+
+		// Same layout as FecSend: [ length(2) | compType(1) | channelAndFlags(1) | <dataId(1)> | data ]
+		vector<byte> symbol( length - 6 );
+		symbol[0] = (byte)(length >> 8);
+		symbol[1] = (byte)length;
+		symbol[2] = data[4];
+		symbol[3] = data[5];
+		Platform::memCpy( symbol.data() + 4, length - 10, data + 10, length - 10 );
+
+		vector<vector<byte>> recovered;
+		{
+			scoped_lock lk( m_Mutex );
+			storeSource( seq, move( symbol ) );
+			for ( auto gIt = m_Groups.begin(); gIt != m_Groups.end(); )
+			{
+				if ( seq - gIt->first < gIt->second.m_K && tryRecover( gIt->first, gIt->second, recovered ) )
+					gIt = m_Groups.erase( gIt );
+				else
+					++gIt;
+			}
+		}
+		for ( auto& r : recovered )
+		{
+			BinSerializer bs;
+			__CHECKED( bs.write( r.data(), (u32)r.size() ) );
+			m_Link.receive( bs, true );
+		}
+	}
+
+	MM_TS void FecRecv::receiveParity( BinSerializer& bs, const PacketInfo& pi )
+	{
+		byte mode, k, m, index;
+		__CHECKED( bs.read( mode ) );
+		__CHECKED( bs.read( k ) );
+		__CHECKED( bs.read( m ) );
+		__CHECKED( bs.read( index ) );
+		u32 length = bs.getWrite() - bs.getRead();
+		if ( k == 0 || m == 0 || index >= m || (u32)k + m > 256 || length < 4 ||
+			 (mode != (byte)EFecMode::Xor && mode != (byte)EFecMode::ReedSolomon) || (mode == (byte)EFecMode::Xor && m != 1) )
+		{
+			LOGW( "Invalid fec parity packet in link %s.", m_Link.info() );
+			return;
+		}
+
+		vector<vector<byte>> recovered;
+		{
+			scoped_lock lk( m_Mutex );
+			// All sources of the group already fell out of the history.
+			if ( !m_Symbols.empty() && !PacketHelper::isSeqNewer( pi.m_Sequence + k - 1, m_Symbols.beginSeq() ) )
+				return;
+			auto gIt = m_Groups.find( pi.m_Sequence );
+			if ( gIt == m_Groups.end() )
+			{
+				Group g;
+				g.m_Mode   = (EFecMode)mode;
+				g.m_K	   = k;
+				g.m_Length = length;
+				g.m_Parity.resize( m );
+				gIt = m_Groups.emplace( pi.m_Sequence, move( g ) ).first;
+			}
+			Group& group = gIt->second;
+			if ( group.m_K != k || group.m_Length != length || group.m_Parity.size() != m || !group.m_Parity[index].empty() )
+				return;
+			group.m_Parity[index].assign( bs.data() + bs.getRead(), bs.data() + bs.getWrite() );
+			if ( tryRecover( pi.m_Sequence, group, recovered ) )
+			{
+				m_Groups.erase( gIt );
+			}
+			prune();
+		}
+		for ( auto& r : recovered )
+		{
+			BinSerializer rbs;
+			__CHECKED( rbs.write( r.data(), (u32)r.size() ) );
+			m_Link.receive( rbs, true );
+		}
+	}
+
+	void FecRecv::storeSource( u32 seq, vector<byte>&& symbol )
+	{
+		if ( m_Symbols.empty() && seq - m_Symbols.beginSeq() >= MM_FEC_RECV_HISTORY )
+		{
+			// Restart the history, leave room for packets that arrive out of order.
+			m_Symbols = SequenceBuffer<vector<byte>>( MM_FEC_RECV_HISTORY, MM_FEC_RECV_HISTORY, seq - MM_FEC_RECV_HISTORY/2 );
+		}
+		if ( !PacketHelper::isSeqNewer( seq, m_Symbols.beginSeq() ) )
+			return;
+		while ( seq - m_Symbols.beginSeq() >= MM_FEC_RECV_HISTORY )
+		{
+			m_Symbols.popFront();
+		}
+		vector<byte>* slot = m_Symbols.insert( seq );
+		if ( slot )
+		{
+			*slot = move( symbol );
+		}
+	}
+
+	// Returns true if the group is no longer needed.
+	bool FecRecv::tryRecover( u32 firstSeq, Group& group, vector<vector<byte>>& recoveredOut )
+	{
+		u32 numMissing = 0;
+		u32 numParity  = 0;
+		for ( u32 i=0; i<group.m_K; ++i )
+		{
+			const vector<byte>* s = m_Symbols.get( firstSeq + i );
+			if ( !s ) numMissing++;
+			else if ( s->size() > group.m_Length ) return true; // Does not belong to this group.
+		}
+		for ( auto& p : group.m_Parity )
+		{
+			if ( !p.empty() ) numParity++;
+		}
+		if ( numMissing == 0 )
+			return true;
+		if ( numMissing > numParity )
+			return false;
+
+		vector<vector<byte>> padded( group.m_K );
+		vector<byte*> sources( group.m_K );
+		unique_ptr<bool[]> present( new bool[group.m_K] );
+		for ( u32 i=0; i<group.m_K; ++i )
+		{
+			const vector<byte>* s = m_Symbols.get( firstSeq + i );
+			present[i] = s != nullptr;
+			if ( s ) padded[i] = *s;
+			padded[i].resize( group.m_Length, 0 );
+			sources[i] = padded[i].data();
+		}
+		vector<const byte*> parity( group.m_Parity.size() );
+		for ( u32 j=0; j<(u32)parity.size(); ++j )
+		{
+			parity[j] = group.m_Parity[j].empty() ? nullptr : group.m_Parity[j].data();
+		}
+		if ( !Fec::decode( group.m_Mode, sources.data(), present.get(), group.m_K, parity.data(), (u32)parity.size(), group.m_Length ) )
+			return true;
+
+		// Rebuild the packets: [ seq(4) | compType(1) | channelAndFlags(1) | timestamp(4) | <dataId(1)> | data ]
+		for ( u32 i=0; i<group.m_K; ++i )
+		{
+			if ( present[i] )
+				continue;
+			const byte* sym = sources[i];
+			u32 length = ((u32)sym[0] << 8) | sym[1];
+			if ( length < MM_RELIABLE_LINK_HDR_SIZE + 2 || length - 6 > group.m_Length )
+			{
+				LOGW( "Fec recovered invalid packet in link %s.", m_Link.info() );
+				continue;
+			}
+			vector<byte> packet( length, 0 );
+			*(u32*)(packet.data()) = Util::htonl( firstSeq + i );
+			packet[4] = sym[2];
+			packet[5] = sym[3];
+			Platform::memCpy( packet.data() + 10, length - 10, sym + 4, length - 10 );
+			recoveredOut.emplace_back( move( packet ) );
+			padded[i].resize( length - 6 );
+			storeSource( firstSeq + i, move( padded[i] ) );
+		}
+		return true;
+	}
+
+	void FecRecv::prune()
+	{
+		for ( auto gIt = m_Groups.begin(); gIt != m_Groups.end(); )
+		{
+			if ( !PacketHelper::isSeqNewer( gIt->first + gIt->second.m_K - 1, m_Symbols.beginSeq() ) )
+				gIt = m_Groups.erase( gIt );
+			else
+				++gIt;
+		}
+	}
+}
\ No newline at end of file
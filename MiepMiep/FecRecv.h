@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+#include "SequenceBuffer.h"
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Rebuilds lost reliable packets of a channel from the parity packets of FecSend.
+		Created when the first parity packet of a channel arrives, from then on the reliable packets of the channel are kept
+		for a while. Rebuilt packets are received as if they came from the socket, except that their ack carries no timestamp echo.
+	*/
+	class FecRecv: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		FecRecv(Link& link);
+		static EComponentType compType() { return EComponentType::FecRecv; }
+
+		MM_TS void addSource( u32 seq, const byte* data, u32 length );
+		MM_TS void receiveParity( class BinSerializer& bs, const struct PacketInfo& pi );
+
+	private:
+		struct Group
+		{
+			EFecMode m_Mode;
+			u32 m_K;
+			u32 m_Length;
+			vector<vector<byte>> m_Parity; // Empty if not received.
+		};
+
+		// NOTE: Require the lock.
+		void storeSource( u32 seq, vector<byte>&& symbol );
+		bool tryRecover( u32 firstSeq, Group& group, vector<vector<byte>>& recoveredOut );
+		void prune();
+
+	private:
+		mutex m_Mutex;
+		SequenceBuffer<vector<byte>> m_Symbols;
+		map<u32, Group> m_Groups;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "FecSend.h"
+#include "Fec.h"
+#include "Link.h"
+#include "LinkStats.h"
+#include "Network.h"
+#include "PacketHelper.h"
+#include "PerThreadDataProvider.h"
+#include "Util.h"
+#include <cmath>
+
+
+namespace MiepMiep
+{
+	FecSend::FecSend(Link& link):
+		ParentLink(link),
+		m_Mode(EFecMode::None),
+		m_FirstSeq(0),
+		m_K(0),
+		m_M(0),
+		m_GroupTS(0)
+	{
+	}
+
+	MM_TS void FecSend::addSource( u32 seq, const byte* data, u32 length, u64 time )
+	{
+		assert( length >= MM_RELIABLE_LINK_HDR_SIZE + 2 );
+		scoped_lock lk( m_Mutex );
+		if ( m_Symbols.empty() || seq != m_FirstSeq + (u32)m_Symbols.size() )
+		{
+			sendParity();
+			beginGroup( seq, time );
+		}
+		if ( m_Mode == EFecMode::None )
+			return;
+
+		// [ length(2) | compType(1) | channelAndFlags(1) | <dataId(1)> | data ]
+		m_Symbols.emplace_back( length - 6 );
+		byte* sym = m_Symbols.back().data();
+		sym[0] = (byte)(length >> 8);
+		sym[1] = (byte)length;
+		sym[2] = data[4];
+		sym[3] = data[5];
+		Platform::memCpy( sym + 4, length - 10, data + 10, length - 10 );
+
+		if ( m_Symbols.size() == m_K )
+		{
+			sendParity();
+		}
+	}
+
+	MM_TS void FecSend::intervalDispatch( u64 time )
+	{
+		scoped_lock lk( m_Mutex );
+		if ( !m_Symbols.empty() && time - m_GroupTS >= MM_FEC_GROUP_TIMEOUT )
+		{
+			sendParity();
+		}
+	}
+
+	void FecSend::beginGroup( u32 seq, u64 time )
+	{
+		m_FirstSeq = seq;
+		m_GroupTS  = time;
+		m_Mode = network().channelFec( (byte)idx() );
+		float loss = m_Link.getOrAdd<LinkStats>()->lossRate();
+		if ( loss < MM_FEC_MIN_LOSS )
+		{
+			m_Mode = EFecMode::None;
+			return;
+		}
+		switch ( m_Mode )
+		{
+		case EFecMode::Xor:
+			m_K = Util::min( Util::max( (u32)(MM_FEC_XOR_TARGET_LOSS / loss), (u32)MM_FEC_MIN_GROUP ), (u32)MM_FEC_MAX_GROUP );
+			m_M = 1;
+			break;
+
+		case EFecMode::ReedSolomon:
+			m_K = MM_FEC_RS_GROUP;
+			m_M = Util::min( Util::max( (u32)ceil( m_K * loss * MM_FEC_RS_REDUNDANCY ), (u32)1 ), (u32)MM_FEC_MAX_PARITY );
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	void FecSend::sendParity()
+	{
+		if ( m_Symbols.empty() )
+			return;
+
+		u32 k = (u32)m_Symbols.size();
+		u32 length = 0;
+		for ( auto& s : m_Symbols ) length = Util::max( length, (u32)s.size() );
+		for ( auto& s : m_Symbols ) s.resize( length, 0 );
+
+		vector<const byte*> sources( k );
+		for ( u32 i=0; i<k; ++i ) sources[i] = m_Symbols[i].data();
+		vector<vector<byte>> parity( m_M, vector<byte>( length ) );
+		vector<byte*> parityPtrs( m_M );
+		for ( u32 j=0; j<m_M; ++j ) parityPtrs[j] = parity[j].data();
+		Fec::encode( m_Mode, sources.data(), k, parityPtrs.data(), m_M, length );
+
+		// [ firstSeq(4) | compType(1) | channelAndFlags(1) | mode(1) | k(1) | m(1) | index(1) | parity ]
+		auto& bs = PerThreadDataProvider::getSerializer( true );
+		for ( u32 j=0; j<m_M; ++j )
+		{
+			__CHECKED( PacketHelper::beginUnfragmented( bs, m_FirstSeq, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
+			__CHECKED( bs.write( (byte)m_Mode ) );
+			__CHECKED( bs.write( (byte)k ) );
+			__CHECKED( bs.write( (byte)m_M ) );
+			__CHECKED( bs.write( (byte)j ) );
+			__CHECKED( bs.write( parity[j].data(), length ) );
+			m_Link.send( bs.data(), bs.length() );
+		}
+		m_Symbols.clear();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Forward error correction for the reliable packets of a channel, see INetwork::setChannelFec.
+		Packets that are sent for the first time are collected in groups of consecutive sequences. When a group is full,
+		or after MM_FEC_GROUP_TIMEOUT, parity packets are sent for it so that the remote (FecRecv) can rebuild lost packets
+		without waiting for a resend. Resends are not protected.
+		The group size and the number of parity packets follow the loss rate of the link. Below MM_FEC_MIN_LOSS, nothing is sent.
+		A packet is protected without its sequence and timestamp, as these are known from the group or differ per resend.
+		Parity packets do not pass through the SendScheduler.
+	*/
+	class FecSend: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		FecSend(Link& link);
+		static EComponentType compType() { return EComponentType::FecSend; }
+
+		// Called by ReliableSend with the packet exactly as it went on the wire.
+		MM_TS void addSource( u32 seq, const byte* data, u32 length, u64 time );
+		MM_TS void intervalDispatch( u64 time );
+
+	private:
+		// NOTE: All require the lock.
+		void beginGroup( u32 seq, u64 time );
+		void sendParity();
+
+	private:
+		mutex m_Mutex;
+		EFecMode m_Mode;
+		u32 m_FirstSeq;
+		u32 m_K;
+		u32 m_M;
+		u64 m_GroupTS;
+		vector<vector<byte>> m_Symbols;
+	};
+}
\ No newline at end of file
@@ -10,20 +10,21 @@ namespace MiepMiep
 	// ------- RPC ------------------------------------------------------------------------------------------
 
 	// [ typeName, id, initData ]
-	MM_RPC( createGroup, string, u32, BinSerializer )
+	MM_RPC( createGroup, string, VarInt<u32>, BinSerializer )
 	{
 		RPC_BEGIN();
-		nw.createRemoteGroup( get<0>( tp ), get<1>( tp ), get<2>( tp ), l.destination() );
+		nw.createRemoteGroup( get<0>( tp ), get<1>( tp ), get<2>( tp ), l, channel );
 	}
 
 
 	// ------- GroupCollection ------------------------------------------------------------------------------------------
 
-	GroupCollection::GroupCollection()
+	GroupCollection::GroupCollection(JobSystem& js):
+		m_Strand(js)
 	{
 	}
 
-	void GroupCollection::addNewPendingGroup( const Session& session, vector<NetVariable*>& vars, const string& typeName,
+	MM_TS void GroupCollection::addNewPendingGroup( const Session& session, vector<NetVariable*>& vars, const string& typeName,
 		const BinSerializer& initData, IDeliveryTrace* trace )
 	{
 		// Do not allow creating a group when no variables are specified.
@@ -38,9 +39,9 @@ namespace MiepMiep
 			(
 				MM_FL, *this, session, vars, typeName, initData, EVarControl::Full
 				);
-		m_PendingGroups.emplace_back( g );
-		network().get<JobSystem>()->addJob( [gc = move( ptr<GroupCollection>() )]
+		m_Strand.post( [gc = move( ptr<GroupCollection>() ), g]
 			{
+				gc->m_PendingGroups.emplace_back( g );
 				gc->tryProcessPendingGroups();
 			} );
 	}
@@ -52,16 +53,20 @@ namespace MiepMiep
 			u32 id = m_IdPool.back();
 			m_IdPool.pop_back();
 			sptr<Group> group = m_PendingGroups.front();
-			m_PendingGroups.pop_back();
+			m_PendingGroups.pop_front();
 			group->setId( id );
-			assert( m_Groups.count( id ) != 0 );
-			m_Groups[id] = group;
+			{
+				scoped_lock lk( m_GroupsMutex );
+				assert( m_Groups.count( id ) == 0 );
+				m_Groups[id] = group;
+			}
 			msgGroupCreate( &group->session(), group->typeName(), group->id(), group->initData() );
 		}
 	}
 
-	sptr<Group> GroupCollection::findGroup( u32 netId ) const
+	MM_TS sptr<Group> GroupCollection::findGroup( u32 netId ) const
 	{
+		scoped_lock lk( m_GroupsMutex );
 		auto gIt = m_Groups.find( netId );
 		if ( gIt != m_Groups.end() )
 			return gIt->second;
@@ -70,6 +75,11 @@ namespace MiepMiep
 
 	// ------- GroupCollectionLink ------------------------------------------------------------------------------------------
 
+	GroupCollectionLink::GroupCollectionLink( Link& link ) :
+		ParentLink( link ),
+		GroupCollection( *link.getInNetwork<JobSystem>() )
+	{
+	}
 
 	Link* GroupCollectionLink::link() const
 	{
@@ -85,7 +95,7 @@ namespace MiepMiep
 	{
 		// Only send group create on this link.
 		assert( !session );
-		m_Link.callRpc<createGroup, string, u32, BinSerializer>
+		m_Link.callRpc<createGroup, string, VarInt<u32>, BinSerializer>
 			(
 				typeName, move( groupId ), initData, false, false,
 				MM_VG_CHANNEL, nullptr
@@ -95,6 +105,11 @@ namespace MiepMiep
 
 	// ------- GroupCollectionNetwork ------------------------------------------------------------------------------------------
 
+	GroupCollectionNetwork::GroupCollectionNetwork( Network& network ) :
+		ParentNetwork( network ),
+		GroupCollection( *network.get<JobSystem>() )
+	{
+	}
 
 	Link* GroupCollectionNetwork::link() const
 	{
@@ -110,7 +125,7 @@ namespace MiepMiep
 	{
 		// Send group create to all.
 		assert( session );
-		network().callRpc2<createGroup, string, u32, BinSerializer>
+		network().callRpc2<createGroup, string, VarInt<u32>, BinSerializer>
 			(
 				typeName, groupId, initData, session, nullptr,
 				false, true, true, true,
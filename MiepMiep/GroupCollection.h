@@ -4,6 +4,7 @@
 #include "Component.h"
 #include "ParentLink.h"
 #include "ParentNetwork.h"
+#include "Strand.h"
 
 
 namespace MiepMiep
@@ -14,24 +15,31 @@ namespace MiepMiep
 	class INetwork;
 	class Session;
 	class NetVariable;
+	class JobSystem;
 
 
 	class GroupCollection : public IComponent, public ITraceable
 	{
 	public:
-		GroupCollection();
+		GroupCollection(JobSystem& js);
 
-		void addNewPendingGroup( const Session& session, vector<NetVariable*>& vars, const string& typeName, const BinSerializer& initData, IDeliveryTrace* trace );
-		void tryProcessPendingGroups();
-		sptr<Group> findGroup( u32 netId ) const;
+		MM_TS void addNewPendingGroup( const Session& session, vector<NetVariable*>& vars, const string& typeName, const BinSerializer& initData, IDeliveryTrace* trace );
+		MM_TS sptr<Group> findGroup( u32 netId ) const;
 
 		virtual Link* link() const = 0;
 		virtual Network& network() const = 0;
 		virtual void msgGroupCreate( const Session* session, const string& typeName, u32 groupId, const BinSerializer& initData ) = 0;
 
 	protected:
+		// NOTE: Runs on the strand.
+		void tryProcessPendingGroups();
+
+	protected:
+		// Pending groups and the id pool are only touched from the strand. Groups are also found from other threads.
+		Strand m_Strand;
 		vector<u32>	  m_IdPool;
 		deque<sptr<Group>>		m_PendingGroups;
+		mutable mutex			m_GroupsMutex;
 		map<u32, sptr<Group>>	m_Groups;
 	};
 
@@ -39,8 +47,7 @@ namespace MiepMiep
 	class GroupCollectionLink : public ParentLink, public GroupCollection
 	{
 	public:
-		GroupCollectionLink( Link& link ) :
-			ParentLink( link ) { }
+		GroupCollectionLink( Link& link );
 
 		static EComponentType compType() { return EComponentType::GroupCollectionLink; }
 
@@ -53,8 +60,7 @@ namespace MiepMiep
 	class GroupCollectionNetwork : public ParentNetwork, public GroupCollection
 	{
 	public:
-		GroupCollectionNetwork( Network& network ) :
-			ParentNetwork( network ) { }
+		GroupCollectionNetwork( Network& network );
 
 		static EComponentType compType() { return EComponentType::GroupCollectionNetwork; }
 
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Common.h"
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace MiepMiep
+{
+	template <typename Signature, u32 Capacity>
+	class InlineFunction;
+
+	/*
+		Move only replacement for std::function that stores the callable in place and never allocates.
+		Callables that do not fit in 'Capacity' bytes fail to compile, capture less (e.g. one ptr<T>() instead of several members).
+	*/
+	template <typename R, typename ...Args, u32 Capacity>
+	class InlineFunction<R (Args...), Capacity>
+	{
+	public:
+		InlineFunction():
+			m_Ops(nullptr) { }
+
+		InlineFunction(std::nullptr_t):
+			m_Ops(nullptr) { }
+
+		template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+		InlineFunction(F&& f)
+		{
+			using Fn = typename std::decay<F>::type;
+			static_assert( sizeof(Fn) <= Capacity, "Callable does not fit in InlineFunction." );
+			static_assert( alignof(Fn) <= alignof(Storage), "Callable is over aligned for InlineFunction." );
+			new (&m_Storage) Fn( std::forward<F>( f ) );
+			m_Ops = OpsFor<Fn>::ops();
+		}
+
+		InlineFunction(InlineFunction&& other):
+			m_Ops(other.m_Ops)
+		{
+			if ( m_Ops )
+			{
+				m_Ops->m_Move( &m_Storage, &other.m_Storage );
+				other.m_Ops = nullptr;
+			}
+		}
+
+		InlineFunction& operator= (InlineFunction&& other)
+		{
+			if ( this != &other )
+			{
+				reset();
+				m_Ops = other.m_Ops;
+				if ( m_Ops )
+				{
+					m_Ops->m_Move( &m_Storage, &other.m_Storage );
+					other.m_Ops = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		InlineFunction(const InlineFunction&) = delete;
+		InlineFunction& operator= (const InlineFunction&) = delete;
+
+		~InlineFunction() { reset(); }
+
+		void reset()
+		{
+			if ( m_Ops )
+			{
+				m_Ops->m_Destroy( &m_Storage );
+				m_Ops = nullptr;
+			}
+		}
+
+		explicit operator bool() const { return m_Ops != nullptr; }
+
+		R operator() (Args... args)
+		{
+			assert( m_Ops );
+			return m_Ops->m_Invoke( &m_Storage, std::forward<Args>( args )... );
+		}
+
+	private:
+		using Storage = typename std::aligned_storage<Capacity, alignof(void*)>::type;
+
+		struct Ops
+		{
+			R	 (*m_Invoke)( void* fn, Args&&... args );
+			void (*m_Move)( void* dst, void* src );		// Move constructs in dst and destroys src.
+			void (*m_Destroy)( void* fn );
+		};
+
+		template <typename Fn>
+		struct OpsFor
+		{
+			static R invoke( void* fn, Args&&... args ) { return (*static_cast<Fn*>(fn))( std::forward<Args>( args )... ); }
+			static void move( void* dst, void* src )	{ new (dst) Fn( std::move( *static_cast<Fn*>(src) ) ); static_cast<Fn*>(src)->~Fn(); }
+			static void destroy( void* fn )				{ static_cast<Fn*>(fn)->~Fn(); }
+			static const Ops* ops()						{ static const Ops o = { &invoke, &move, &destroy }; return &o; }
+		};
+
+		const Ops* m_Ops;
+		Storage m_Storage;
+	};
+}
\ No newline at end of file
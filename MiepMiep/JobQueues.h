@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Common.h"
+#include <atomic>
+#include <vector>
+
+
+namespace MiepMiep
+{
+	/*
+		Chase-Lev work stealing deque of fixed power of two capacity (Le et al., 'Correct and Efficient Work-Stealing for
+		Weak Memory Models'). Only the owning thread pushes and pops at the bottom, any thread may steal from the top.
+		T must be trivially copyable and small, in practice a pointer. Push fails when the deque is full.
+	*/
+	template <typename T>
+	class WorkStealingDeque
+	{
+	public:
+		WorkStealingDeque(u32 capacity);
+
+		// Owner only.
+		bool push( T item );
+		bool pop( T& item );
+
+		// Any thread. Also fails if it lost a race with another thief or with the owner, the caller simply tries elsewhere.
+		bool steal( T& item );
+		bool empty() const;
+
+	private:
+		// Separate cache lines, the owner writes bottom while thieves write top.
+		alignas(64) std::atomic<i64> m_Top;
+		alignas(64) std::atomic<i64> m_Bottom;
+		i64 m_Mask;
+		std::vector<std::atomic<T>> m_Items;
+	};
+
+
+	/*
+		Bounded multi producer multi consumer queue (Vyukov). Each slot carries a sequence number that tells whether it
+		is free to write or ready to read at the current lap, so producers and consumers only contend on a single CAS.
+		Push fails when the queue is full.
+	*/
+	template <typename T>
+	class MpmcQueue
+	{
+	public:
+		MpmcQueue(u32 capacity);
+
+		bool push( T item );
+		bool pop( T& item );
+		bool empty() const;
+
+	private:
+		struct Slot
+		{
+			std::atomic<u64> m_Seq;
+			T m_Item;
+		};
+
+		alignas(64) std::atomic<u64> m_Head;
+		alignas(64) std::atomic<u64> m_Tail;
+		u64 m_Mask;
+		std::vector<Slot> m_Slots;
+	};
+
+
+	// ------ WorkStealingDeque --------------------------------------------------------------------------------
+
+	template <typename T>
+	WorkStealingDeque<T>::WorkStealingDeque(u32 capacity):
+		m_Top(0),
+		m_Bottom(0),
+		m_Mask(capacity-1),
+		m_Items(capacity)
+	{
+		assert( capacity != 0 && (capacity & (capacity-1)) == 0 );
+	}
+
+	template <typename T>
+	bool WorkStealingDeque<T>::push( T item )
+	{
+		i64 b = m_Bottom.load( std::memory_order_relaxed );
+		i64 t = m_Top.load( std::memory_order_acquire );
+		if ( b - t > m_Mask )
+			return false;
+		m_Items[b & m_Mask].store( item, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		m_Bottom.store( b+1, std::memory_order_relaxed );
+		return true;
+	}
+
+	template <typename T>
+	bool WorkStealingDeque<T>::pop( T& item )
+	{
+		i64 b = m_Bottom.load( std::memory_order_relaxed ) - 1;
+		m_Bottom.store( b, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		i64 t = m_Top.load( std::memory_order_relaxed );
+		if ( t > b )
+		{
+			// Was empty.
+			m_Bottom.store( b+1, std::memory_order_relaxed );
+			return false;
+		}
+		item = m_Items[b & m_Mask].load( std::memory_order_relaxed );
+		if ( t == b )
+		{
+			// Last item, race thieves for it.
+			bool won = m_Top.compare_exchange_strong( t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed );
+			m_Bottom.store( b+1, std::memory_order_relaxed );
+			return won;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool WorkStealingDeque<T>::steal( T& item )
+	{
+		i64 t = m_Top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		i64 b = m_Bottom.load( std::memory_order_acquire );
+		if ( t >= b )
+			return false;
+		item = m_Items[t & m_Mask].load( std::memory_order_relaxed );
+		return m_Top.compare_exchange_strong( t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed );
+	}
+
+	template <typename T>
+	bool WorkStealingDeque<T>::empty() const
+	{
+		return m_Top.load( std::memory_order_acquire ) >= m_Bottom.load( std::memory_order_acquire );
+	}
+
+
+	// ------ MpmcQueue --------------------------------------------------------------------------------
+
+	template <typename T>
+	MpmcQueue<T>::MpmcQueue(u32 capacity):
+		m_Head(0),
+		m_Tail(0),
+		m_Mask(capacity-1),
+		m_Slots(capacity)
+	{
+		assert( capacity >= 2 && (capacity & (capacity-1)) == 0 );
+		for ( u64 i=0; i<capacity; ++i )
+		{
+			m_Slots[i].m_Seq.store( i, std::memory_order_relaxed );
+		}
+	}
+
+	template <typename T>
+	bool MpmcQueue<T>::push( T item )
+	{
+		u64 pos = m_Tail.load( std::memory_order_relaxed );
+		while ( true )
+		{
+			Slot& s = m_Slots[pos & m_Mask];
+			i64 diff = (i64)(s.m_Seq.load( std::memory_order_acquire ) - pos);
+			if ( diff == 0 )
+			{
+				if ( m_Tail.compare_exchange_weak( pos, pos+1, std::memory_order_relaxed ) )
+				{
+					s.m_Item = item;
+					s.m_Seq.store( pos+1, std::memory_order_release );
+					return true;
+				}
+			}
+			else if ( diff < 0 )
+			{
+				return false; // Full.
+			}
+			else
+			{
+				pos = m_Tail.load( std::memory_order_relaxed );
+			}
+		}
+	}
+
+	template <typename T>
+	bool MpmcQueue<T>::pop( T& item )
+	{
+		u64 pos = m_Head.load( std::memory_order_relaxed );
+		while ( true )
+		{
+			Slot& s = m_Slots[pos & m_Mask];
+			i64 diff = (i64)(s.m_Seq.load( std::memory_order_acquire ) - (pos+1));
+			if ( diff == 0 )
+			{
+				if ( m_Head.compare_exchange_weak( pos, pos+1, std::memory_order_relaxed ) )
+				{
+					item = s.m_Item;
+					s.m_Seq.store( pos + m_Mask + 1, std::memory_order_release );
+					return true;
+				}
+			}
+			else if ( diff < 0 )
+			{
+				return false; // Empty.
+			}
+			else
+			{
+				pos = m_Head.load( std::memory_order_relaxed );
+			}
+		}
+	}
+
+	template <typename T>
+	bool MpmcQueue<T>::empty() const
+	{
+		return m_Head.load( std::memory_order_acquire ) >= m_Tail.load( std::memory_order_acquire );
+	}
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "JobSystem.h"
+#include "Strand.h"
 #include "Platform.h"
 #include <cassert>
 #include <sstream>
@@ -6,11 +7,19 @@
 
 namespace MiepMiep
 {
+	// Worker that runs on the calling thread, if any. Used to push jobs from within a job to the own deque.
+	static thread_local WorkerThread* tl_worker = nullptr;
+
+
 	// ------------ WorkerThread --------------------------------------------------------------------------------
 
-	WorkerThread::WorkerThread(JobSystem& js):
+	WorkerThread::WorkerThread(JobSystem& js, u32 idx):
+		m_Deque(MM_JOB_DEQUE_SIZE),
 		m_Js(js),
-		m_Closing(false)
+		m_Idx(idx),
+		m_Random(idx*2654435761U + 1),
+		m_FreeJobs(nullptr),
+		m_NumFreeJobs(0)
 	{
 	}
 
@@ -22,7 +31,7 @@ namespace MiepMiep
 	MM_TS void WorkerThread::start()
 	{
 		set_terminate([]()
-		{ 
+		{
 			LOGC( "Worker thread encountered exception." );
 			abort();
 		});
@@ -30,30 +39,34 @@ namespace MiepMiep
 		m_Thread = thread([&]
 		/* This is the thread function */
 		{
-			while ( true )
+			tl_worker = this;
+			u32 idleRounds = 0;
+			while ( !m_Js.isClosing() )
 			{
-				unique_lock<mutex> lk( m_Js.getMutex() );
-				if ( m_Js.isClosing() )
-				{
-					break;
-				}
-				Job j = m_Js.extractJob();
-				if ( !j.valid() )
+				Job* j = m_Js.extractJob( *this );
+				if ( !j )
 				{
-					m_Js.suspend( lk );
-					j = m_Js.extractJob();
-				}
-				lk.unlock();
-				if ( j.valid() )
-				{
-				#if MM_TRACE_JOBSYSTEM
-					stringstream ss;
-					this_thread::get_id()._To_text( ss );
-					LOG( "Thread %s starts to execute job.", ss.str().c_str() );
-				#endif
-					j.m_WorkFunc();
+					if ( ++idleRounds < MM_JOB_SPIN_ROUNDS )
+					{
+						this_thread::yield();
+					}
+					else
+					{
+						idleRounds = 0;
+						m_Js.suspend();
+					}
+					continue;
 				}
+				idleRounds = 0;
+			#if MM_TRACE_JOBSYSTEM
+				stringstream ss;
+				this_thread::get_id()._To_text( ss );
+				LOG( "Thread %s starts to execute job.", ss.str().c_str() );
+			#endif
+				j->m_WorkFunc();
+				m_Js.freeJob( j );
 			}
+			tl_worker = nullptr;
 		});
 	}
 
@@ -70,14 +83,22 @@ namespace MiepMiep
 	JobSystem::JobSystem(Network& network, u32 numWorkerThreads):
 		ParentNetwork(network),
 		m_Closing(false),
-		m_NumThreadsSleeping(0)
+		m_Injected(MM_JOB_INJECT_SIZE),
+		m_NumOverflow(0),
+		m_NumThreadsSleeping(0),
+		m_FreeJobs(nullptr),
+		m_NumHeapAllocations(0)
 	{
 	#if MM_MT
 		assert( numWorkerThreads != 0 );
+		// Create all workers before starting any, as workers steal from each other.
 		for (u32 i = 0; i < numWorkerThreads ; i++)
 		{
-			m_WorkerThreads.push_back( make_unique<WorkerThread>(*this) );
-			m_WorkerThreads.back()->start();
+			m_WorkerThreads.push_back( make_unique<WorkerThread>(*this, i) );
+		}
+		for ( auto& wt : m_WorkerThreads )
+		{
+			wt->start();
 		}
 	#endif
 	}
@@ -87,66 +108,198 @@ namespace MiepMiep
 		stop();
 	}
 
-	MM_TS void JobSystem::addJob(const std::function<void()>& cb)
+	MM_TS void JobSystem::addJob(JobFunc&& cb)
 	{
 		#if !MM_MT
 			cb();
 			return;
 		#endif
 
+		if ( m_Closing )
+			return;
+		Job* j = allocJob();
+		j->m_WorkFunc = move( cb );
+		push( j );
+		wakeOne();
+	}
+
+	MM_TS void JobSystem::push( Job* job )
+	{
+		WorkerThread* wt = tl_worker;
+		if ( wt && &wt->m_Js == this && wt->m_Deque.push( job ) )
+			return;
+		if ( m_Injected.push( job ) )
+			return;
+		scoped_lock lk( m_OverflowMutex );
+		m_Overflow.push( job );
+		m_NumOverflow++;
+	}
+
+	MM_TS Job* JobSystem::extractJob( WorkerThread& wt )
+	{
+		Job* j;
+		if ( wt.m_Deque.pop( j ) )
+			return j;
+		if ( m_Injected.pop( j ) )
+			return j;
+		u32 numWorkers = (u32)m_WorkerThreads.size();
+		if ( numWorkers > 1 )
+		{
+			// Xorshift, start at a random victim and try each once.
+			wt.m_Random ^= wt.m_Random << 13;
+			wt.m_Random ^= wt.m_Random >> 17;
+			wt.m_Random ^= wt.m_Random << 5;
+			wt.m_Random &= 0xFFFFFFFF;
+			u32 start = wt.m_Random % numWorkers;
+			for ( u32 i=0; i<numWorkers; ++i )
+			{
+				WorkerThread& victim = *m_WorkerThreads[(start + i) % numWorkers];
+				if ( &victim != &wt && victim.m_Deque.steal( j ) )
+					return j;
+			}
+		}
+		if ( m_NumOverflow.load() != 0 )
+		{
+			scoped_lock lk( m_OverflowMutex );
+			if ( !m_Overflow.empty() )
+			{
+				j = m_Overflow.front();
+				m_Overflow.pop();
+				m_NumOverflow--;
+				return j;
+			}
+		}
+		return nullptr;
+	}
+
+	MM_TS bool JobSystem::hasJobs() const
+	{
+		if ( !m_Injected.empty() || m_NumOverflow.load() != 0 )
+			return true;
+		for ( auto& wt : m_WorkerThreads )
+		{
+			if ( !wt->m_Deque.empty() )
+				return true;
+		}
+		return false;
+	}
+
+	MM_TS void JobSystem::suspend()
+	{
 		#if MM_TRACE_JOBSYSTEM
 			stringstream ss;
 			this_thread::get_id()._To_text( ss );
-			LOG( "Thread %s locks.", ss.str().c_str() );
+			LOG( "Thread %s suspends.", ss.str().c_str() );
 		#endif
-		m_JobsMutex.lock();
-		m_GlobalQueue.push ( { cb } );
-		if ( m_NumThreadsSleeping > 0 )
+		unique_lock<mutex> lk( m_SleepMutex );
+		// Announce sleeping before checking for jobs. Together with the fence in wakeOne, either this sees the new job
+		// or the producer sees a sleeping thread.
+		m_NumThreadsSleeping.fetch_add( 1 );
+		atomic_thread_fence( memory_order_seq_cst );
+		if ( !m_Closing && !hasJobs() )
 		{
-			m_QueueCv.notify_one();
-			m_NumThreadsSleeping--;
+			m_SleepCv.wait( lk );
 		}
-		m_JobsMutex.unlock();
-		#if MM_TRACE_JOBSYSTEM
-			stringstream ss2;
-			this_thread::get_id()._To_text( ss2 );
-			LOG( "Thread %s unlocks.", ss2.str().c_str() );
-		#endif
-		//m_QueueCv.notify_one();
+		m_NumThreadsSleeping.fetch_sub( 1 );
+	}
+
+	MM_TS void JobSystem::wakeOne()
+	{
+		atomic_thread_fence( memory_order_seq_cst );
+		if ( m_NumThreadsSleeping.load() != 0 )
+		{
+			scoped_lock lk( m_SleepMutex );
+			m_SleepCv.notify_one();
+		}
+	}
+
+	MM_TS void JobSystem::clearJobs()
+	{
+		Job* j;
+		for ( auto& wt : m_WorkerThreads )
+		{
+			while ( wt->m_Deque.pop( j ) ) discardJob( j );
+		}
+		while ( m_Injected.pop( j ) ) discardJob( j );
+		scoped_lock lk( m_OverflowMutex );
+		while ( !m_Overflow.empty() )
+		{
+			discardJob( m_Overflow.front() );
+			m_Overflow.pop();
+		}
+		m_NumOverflow = 0;
 	}
 
-	MM_TS Job JobSystem::extractJob()
+	MM_TS void JobSystem::discardJob( Job* job )
 	{
-		if ( !m_GlobalQueue.empty() )
+		// A strand whose job is discarded would never run again and its queued callbacks would keep what they captured alive.
+		Strand* strand = job->m_Strand;
+		freeJob( job );
+		if ( strand )
 		{
-			Job j = m_GlobalQueue.front();
-			m_GlobalQueue.pop();
+			strand->drop();
+		}
+	}
+
+	MM_TS Job* JobSystem::allocJob()
+	{
+		WorkerThread* wt = tl_worker;
+		if ( wt && &wt->m_Js == this && wt->m_FreeJobs )
+		{
+			Job* j = wt->m_FreeJobs;
+			wt->m_FreeJobs = j->m_Next;
+			wt->m_NumFreeJobs--;
 			return j;
 		}
-		return Job();
+		scoped_spinlock lk( m_PoolLock );
+		if ( !m_FreeJobs )
+		{
+			uptr<Job[]> chunk( new Job[MM_JOB_POOL_CHUNK] );
+			for ( u32 i=0; i<MM_JOB_POOL_CHUNK; ++i )
+			{
+				chunk[i].m_Next = m_FreeJobs;
+				m_FreeJobs = &chunk[i];
+			}
+			m_JobChunks.emplace_back( move( chunk ) );
+			m_NumHeapAllocations++;
+		}
+		Job* j = m_FreeJobs;
+		m_FreeJobs = j->m_Next;
+		return j;
 	}
 
-	MM_TS void JobSystem::suspend(unique_lock<mutex>& ul)
+	MM_TS void JobSystem::freeJob( Job* job )
 	{
-		#if MM_TRACE_JOBSYSTEM
-			stringstream ss;
-			this_thread::get_id()._To_text( ss );
-			LOG( "Thread %s suspends -> loses lock.", ss.str().c_str() );
-		#endif
-		m_NumThreadsSleeping++;
-		m_QueueCv.wait( ul );
+		job->m_WorkFunc.reset();
+		job->m_Strand = nullptr;
+		WorkerThread* wt = tl_worker;
+		if ( wt && &wt->m_Js == this && wt->m_NumFreeJobs < MM_JOB_POOL_CHUNK )
+		{
+			job->m_Next = wt->m_FreeJobs;
+			wt->m_FreeJobs = job;
+			wt->m_NumFreeJobs++;
+			return;
+		}
+		scoped_spinlock lk( m_PoolLock );
+		job->m_Next = m_FreeJobs;
+		m_FreeJobs = job;
 	}
 
 	MM_TS void JobSystem::stop()
 	{
 	#if MM_MT
-		m_JobsMutex.lock();
-		m_Closing = true;
-		m_QueueCv.notify_all();
-		m_JobsMutex.unlock();
+		{
+			scoped_lock lk( m_SleepMutex );
+			m_Closing = true;
+			m_SleepCv.notify_all();
+		}
+		// Workers are joined first, after which their deques can be emptied from this thread.
+		for ( auto& wt : m_WorkerThreads )
+		{
+			wt->stop();
+		}
+		clearJobs();
 		m_WorkerThreads.clear();
-		scoped_lock lk(m_JobsMutex);
-		while ( !m_GlobalQueue.empty() ) m_GlobalQueue.pop();
 	#endif
 	}
 
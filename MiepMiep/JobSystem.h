@@ -3,7 +3,9 @@
 #include "Component.h"
 #include "Memory.h"
 #include "ParentNetwork.h"
-#include <functional>
+#include "JobQueues.h"
+#include "InlineFunction.h"
+#include "Threading.h"
 #include <thread>
 #include <queue>
 #include <condition_variable>
@@ -14,28 +16,46 @@ namespace MiepMiep
 {
 	class Network;
 
+	using JobFunc = InlineFunction<void (), MM_JOB_FUNC_SIZE>;
+
+	// Jobs are nodes from the JobSystem's pool and are reused, so that adding a job does not allocate.
 	struct Job
 	{
-		// No locking, but before job is pushed in list its worker func is either set or not. It is never changed afterwards.
-		bool valid() const { return m_WorkFunc!=nullptr; }
-		std::function<void ()> m_WorkFunc;
+		JobFunc m_WorkFunc;
+		class Strand* m_Strand = nullptr; // Set if the job runs a strand, whose queue must be dropped if the job is discarded.
+		Job* m_Next = nullptr; // In a free list or in the queue of a strand.
 	};
+	static_assert( sizeof(Job) <= 64, "Job node exceeds a cache line, lower MM_JOB_FUNC_SIZE." );
 
 
 	class WorkerThread
 	{
 	public:
-		WorkerThread(class JobSystem& js);
+		WorkerThread(class JobSystem& js, u32 idx);
 		~WorkerThread();
 		MM_TS void start();
 		MM_TS void stop();
 
+		// Jobs added from this worker go to the bottom of its own deque, other workers steal from the top.
+		WorkStealingDeque<Job*> m_Deque;
 		thread m_Thread;
 		class JobSystem& m_Js;
-		volatile bool m_Closing;
+		u32 m_Idx;
+		u32 m_Random; // Picks the victim to steal from.
+		Job* m_FreeJobs;
+		u32 m_NumFreeJobs;
 	};
 
 
+	/*
+		Each worker owns a deque to which the jobs it adds are pushed and from which it pops without contention.
+		Jobs from other threads (socket reception, the send thread) go to a lock free injection queue, or if that is full,
+		to an overflow queue behind a mutex. A worker without jobs takes from the injection queue and otherwise steals
+		from a random other worker. Only after a number of failed rounds it goes to sleep. Adding a job only takes the
+		sleep mutex to wake a worker if one is sleeping.
+		Job nodes come from a pool that grows in chunks. Workers keep their own list of free nodes, other threads take them
+		from the shared list behind a spinlock. Once the pool is warm, adding a job does not allocate.
+	*/
 	class JobSystem: public ParentNetwork, public IComponent, public ITraceable
 	{
 	public:
@@ -45,25 +65,41 @@ namespace MiepMiep
 		static EComponentType compType() { return EComponentType::JobSystem; }
 
 
-		MM_TS void addJob( const std::function<void ()>& cb );
+		MM_TS void addJob( JobFunc&& cb );
 		MM_TS void stop();
 		MM_TS bool isClosing() const volatile { return m_Closing; }
 
-	private:
-		MM_TS Job extractJob();
-		MM_TS mutex& getMutex() { return m_JobsMutex; }
-		MM_TS void suspend(unique_lock<mutex>& ul);
+		// Number of times the job pool allocated from the heap. Stays constant under a steady load.
+		MM_TS u64 numHeapAllocations() const { return m_NumHeapAllocations; }
 
+	private:
+		MM_TS void push( Job* job );
+		MM_TS Job* extractJob( WorkerThread& wt );
+		MM_TS bool hasJobs() const;
+		MM_TS void suspend();
+		MM_TS void wakeOne();
+		MM_TS void clearJobs();
+		MM_TS void discardJob( Job* job );
+		MM_TS Job* allocJob();
+		MM_TS void freeJob( Job* job );
 
 	private:
 		volatile bool m_Closing;
-		mutex m_JobsMutex;
-		u32 m_NumThreadsSleeping;
-		queue<Job> m_GlobalQueue;
-		condition_variable m_QueueCv;
 		vector<uptr<WorkerThread>> m_WorkerThreads;
+		MpmcQueue<Job*> m_Injected;
+		atomic<u32> m_NumOverflow;
+		mutex m_OverflowMutex;
+		queue<Job*> m_Overflow;
+		atomic<u32> m_NumThreadsSleeping;
+		mutex m_SleepMutex;
+		condition_variable m_SleepCv;
+		SpinLock m_PoolLock;
+		Job* m_FreeJobs;
+		vector<uptr<Job[]>> m_JobChunks;
+		atomic<u64> m_NumHeapAllocations;
 
 		friend class WorkerThread;
+		friend class Strand;
 	};
 
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "Endpoint.h"
 #include "Socket.h"
 #include "LinkState.h"
+#include "LinkStats.h"
 #include "ReliableRecv.h"
 #include "UnreliableRecv.h"
 #include "ReliableNewRecv.h"
@@ -13,6 +14,11 @@
 #include "ReliableNewestAckRecv.h"
 #include "ReliableAckSend.h"
 #include "ReliableAckRecv.h"
+#include "MtuDiscovery.h"
+#include "FecRecv.h"
+#include "StreamRecv.h"
+#include "RpcIdTable.h"
+#include "SendScheduler.h"
 #include "SocketSetManager.h"
 #include "MasterSession.h"
 #include "Util.h"
@@ -20,6 +26,31 @@
 
 namespace MiepMiep
 {
+	// -------- Event --------------------------------------------------------------------------------
+
+
+	struct EventRpc : IEvent
+	{
+		// The payload shares the bytes of the received packet.
+		EventRpc(const sptr<Link>& link, const RpcFunc& rpcFunc, RecvPacket&& payload, bool isSystemRpc):
+			IEvent( link, isSystemRpc),
+			m_RpcFunc(rpcFunc),
+			m_Payload(move(payload))
+		{
+		}
+
+		void process() override
+		{
+			auto& bs = PerThreadDataProvider::getSerializer(false);
+			bs.view( m_Payload.m_Buffer, m_Payload.m_Data, m_Payload.m_Length );
+			m_RpcFunc( m_Link->m_Network, *m_Link, bs, (m_Payload.m_Flags & MM_CHANNEL_MASK) );
+		}
+
+		RpcFunc m_RpcFunc;
+		RecvPacket  m_Payload;
+	};
+
+
 	// -------- ILink ----------------------------------------------------------------------------------------------------
 
 	MM_TS sptr<ILink> ILink::to_ptr()
@@ -73,6 +104,8 @@ namespace MiepMiep
 		}
 
 		link->m_SockAddrPair = sap;
+		link->getOrAdd<MtuDiscovery>();
+		link->getOrAdd<SendScheduler>();
 		if ( session )
 		{
 			if ( !session->addLink( link ) )
@@ -104,6 +137,18 @@ namespace MiepMiep
 		return ls && ls->state() == ELinkState::Connected;
 	}
 
+	u32 Link::queuedSendBytes() const
+	{
+		auto stats = get<LinkStats>();
+		return stats ? stats->queuedSendBytes() : 0;
+	}
+
+	u32 Link::queuedSendPackets() const
+	{
+		auto stats = get<LinkStats>();
+		return stats ? stats->queuedSendPackets() : 0;
+	}
+
 	SessionBase* Link::getSession() const
 	{
 		return m_Session.get();
@@ -174,11 +219,16 @@ namespace MiepMiep
 		// TODO
 	}
 
-	void Link::receive(BinSerializer& bs)
+	void Link::receive(BinSerializer& bs, bool isRecovered)
 	{
 		byte compType;
 		PacketInfo pi;
 
+		if ( !isRecovered )
+		{
+			getOrAdd<LinkStats>()->addReceivedBytes( bs.length() );
+		}
+
 		__CHECKED( bs.read(pi.m_Sequence) );
 		__CHECKED( bs.read(compType) );
 		__CHECKED( bs.read(pi.m_ChannelAndFlags) );
@@ -189,16 +239,34 @@ namespace MiepMiep
 		switch ( ct )
 		{
 		case EComponentType::ReliableSend:
-			getOrAdd<ReliableAckSend>(channel)->addAck( pi.m_Sequence );
-			getOrAdd<ReliableRecv>(channel)->receive( bs, pi );
-			break;
+		{
+			u32 timestamp;
+			__CHECKED( bs.read(timestamp) );
+			if ( !isRecovered )
+			{
+				if ( auto fec = get<FecRecv>(channel) )
+				{
+					fec->addSource( pi.m_Sequence, bs.data(), bs.length() );
+				}
+			}
+			// Packets that did not fit in the receive window are not acked, so that the sender resends them.
+			if ( getOrAdd<ReliableRecv>(channel)->receive( bs, pi ) )
+			{
+				// The timestamp of a recovered packet is lost.
+				if ( isRecovered )
+					getOrAdd<ReliableAckSend>(channel)->addAck( pi.m_Sequence );
+				else
+					getOrAdd<ReliableAckSend>(channel)->addAck( pi.m_Sequence, timestamp );
+			}
+		}
+		break;
 
 		case EComponentType::UnreliableSend:
-			getOrAdd<UnreliableRecv>(channel)->receive( bs );
+			getOrAdd<UnreliableRecv>(channel)->receive( bs, pi );
 			break;
 
 		case EComponentType::ReliableNewSend:
-			getOrAdd<ReliableNewRecv>()->receive( bs );
+			getOrAdd<ReliableNewRecv>(channel)->receive( bs, pi );
 			break;
 
 			// -- Acks --
@@ -208,7 +276,17 @@ namespace MiepMiep
 			break;
 
 		case EComponentType::ReliableNewAckSend:
-			getOrAdd<ReliableNewestAckRecv>()->receive( bs );
+			getOrAdd<ReliableNewestAckRecv>(channel)->receive( bs );
+			break;
+
+			// -- Other --
+
+		case EComponentType::MtuDiscovery:
+			getOrAdd<MtuDiscovery>()->receive( bs, pi );
+			break;
+
+		case EComponentType::FecSend:
+			getOrAdd<FecRecv>(channel)->receiveParity( bs, pi );
 			break;
 
 		default:
@@ -217,16 +295,90 @@ namespace MiepMiep
 		}
 	}
 
-	void Link::send(const byte* data, u32 length)
+	MM_TS void Link::handlePacket(const RecvPacket& pack)
+	{
+		if ( pack.m_Flags & MM_COMPRESSED_BIT )
+		{
+			u64 startTime = Util::abs_time_us();
+			sptr<const RecvPacket> original = PacketHelper::decompress( pack, m_Network.compressionDictionary().get() );
+			if ( !original )
+			{
+				LOGW( "Received corrupt compressed packet on link %s, data id was %d.", info(), (u32)pack.m_Id );
+				return;
+			}
+			getOrAdd<LinkStats>()->addDecompressed( (u32)(Util::abs_time_us() - startTime) );
+			handlePacket( *original );
+			return;
+		}
+
+		EPacketType pt = sc<EPacketType>( pack.m_Id );
+		switch (pt)
+		{
+		case EPacketType::RPC:
+			handleRpc( pack );
+			break;
+
+		case EPacketType::Stream:
+			getOrAdd<StreamRecv>()->receive( pack );
+			break;
+
+		case EPacketType::UserOffsetStart:
+			// TODO add event with user data
+			break;
+
+		default:
+			LOGW( "Unhandled packet received, data id was %d.", (byte)pt );
+			break;
+		}
+	}
+
+	MM_TS void Link::handleRpc(const RecvPacket& pack)
+	{
+		auto& bs = PerThreadDataProvider::getSerializer( false );
+		bs.resetTo( pack.m_Data, pack.m_Length, pack.m_Length );
+
+		u32 hdr;
+		__CHECKED( bs.readVarint( hdr ) );
+		u32 rpcId = hdr >> 1;
+		RpcFunc rpcFunc;
+		if ( hdr & 1 )
+		{
+			u32 rpcHash;
+			__CHECKED( bs.read( rpcHash ) );
+			rpcFunc = getOrAdd<RpcIdTable>()->define( rpcId, rpcHash );
+			if ( !rpcFunc )
+			{
+				LOGC( "Cannot find rpc with hash %x.", rpcHash );
+				return;
+			}
+		}
+		else
+		{
+			rpcFunc = getOrAdd<RpcIdTable>()->find( rpcId );
+			if ( !rpcFunc )
+			{
+				LOGC( "Cannot find rpc with id %d from link %s.", rpcId, info() );
+				return;
+			}
+		}
+
+		pushEvent<EventRpc>( rpcFunc, pack.slice( bs.getRead() ), (pack.m_Flags & MM_SYSTEM_BIT) );
+	}
+
+	ESendResult Link::send(const byte* data, u32 length)
 	{
 		if ( !m_SockAddrPair.m_Socket )
 		{
 			LOGC( "Invalid socket, cannot send." );
-			return;
+			return ESendResult::SocketClosed;
 		}
 
 		i32 err = 0;
 		ESendResult res = m_SockAddrPair.m_Socket->send( sc<const Endpoint&>( *m_SockAddrPair.m_Address ), data, length, &err );
+		if ( ESendResult::Succes == res )
+		{
+			getOrAdd<LinkStats>()->addSentBytes( length );
+		}
 	
 	//	thread_local static u32 kt=0;	
 	//	LOG( "Send ... %d", kt++ );
@@ -235,6 +387,7 @@ namespace MiepMiep
 		{
 			LOGW( "Socket send error %d.", err );
 		}
+		return res;
 	}
 
 	MM_TO_PTR_IMP( Link )
@@ -37,6 +37,8 @@ namespace MiepMiep
 		const IAddress& destination() const override { return *m_SockAddrPair.m_Address; }
 		const IAddress& source() const override { return *m_Source; }
 		bool  isConnected() const override;
+		u32   queuedSendBytes() const override;
+		u32   queuedSendPackets() const override;
 		SessionBase* getSession() const;
 
 		const ISocket& socket() const { return *m_SockAddrPair.m_Socket; }
@@ -55,7 +57,7 @@ namespace MiepMiep
 		void destroyGroup( u32 id );
 
 		template <typename T, typename ...Args>
-		ESendCallResult callRpc(Args... args, bool localCall=false, bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr);
+		ESendCallResult callRpc(const Args&... args, bool localCall=false, bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr);
 
 		template <typename T, typename ...Args>
 		void pushEvent(Args&&... args); 
@@ -69,11 +71,18 @@ namespace MiepMiep
 		template <typename T, typename ...Args>
 		sptr<T> getOrAddInNetwork(u32 idx=0, Args&&... args);
 
-		void receive( BinSerializer& bs );
-		void send( const byte* data, u32 length );
+		// 'isRecovered' is true for packets rebuilt by forward error correction.
+		void receive( BinSerializer& bs, bool isRecovered=false );
+		ESendResult send( const byte* data, u32 length );
+
+		// Called for each complete message, in order for reliable channels.
+		MM_TS void handlePacket( const RecvPacket& pack );
 
 		MM_TO_PTR( Link )
 
+	private:
+		MM_TS void handleRpc( const RecvPacket& pack );
+
 	private:
 		// All these fields could have their own component, but that is a lot of boilerplate for a single field.
 		sptr<SessionBase> m_Session;
@@ -84,17 +93,17 @@ namespace MiepMiep
 
 
 	template <typename T, typename ...Args>
-	ESendCallResult MiepMiep::Link::callRpc(Args... args, bool localCall, bool relay, byte channel, IDeliveryTrace* trace)
+	ESendCallResult MiepMiep::Link::callRpc(const Args&... args, bool localCall, bool relay, byte channel, IDeliveryTrace* trace)
 	{
 		auto& bs = priv_get_thread_serializer();
 		T::rpc<Args...>(args..., m_Network, bs, localCall, channel);
-		return priv_send_rpc( m_Network, T::rpcName(), bs, nullptr, this, false /* buffer */, relay, true /* sys bit */, channel, trace );
+		return priv_send_rpc( m_Network, T::rpcHeader(), bs, nullptr, this, false /* buffer */, relay, true /* sys bit */, channel, trace );
 	}
 
 	template <typename T, typename ...Args>
 	void Link::pushEvent(Args&&... args)
 	{
-		sptr<T> evt = make_shared<T>(to_ptr(), args...);
+		sptr<T> evt = make_shared<T>(to_ptr(), std::forward<Args>(args)...);
 		sptr<IEvent> evtDown = static_pointer_cast<IEvent>(evt);
 		auto ne = m_Network.get<NetworkEvents>();
 		if ( ne )
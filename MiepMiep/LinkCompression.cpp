@@ -0,0 +1,36 @@
+#include "LinkCompression.h"
+#include "Link.h"
+#include "Network.h"
+#include "Rpc.h"
+
+
+namespace MiepMiep
+{
+	// ------ Rpc --------------------------------------------------------------------------------
+
+	MM_RPC( linkCompressionAnnounce, u32 )
+	{
+		RPC_BEGIN_NO_S();
+		l.getOrAdd<LinkCompression>()->setRemoteId( get<0>( tp ) );
+	}
+
+
+	// ------ LinkCompression --------------------------------------------------------------------------------
+
+	LinkCompression::LinkCompression(Link& link):
+		ParentLink(link),
+		m_RemoteId(0)
+	{
+	}
+
+	MM_TS void LinkCompression::announce()
+	{
+		m_Link.callRpc<linkCompressionAnnounce, u32>( network().compressionId(), No_Local, No_Relay, MM_RPC_CHANNEL, No_Trace );
+	}
+
+	MM_TS bool LinkCompression::isEnabled()
+	{
+		u32 id = network().compressionId();
+		return id != 0 && m_RemoteId == id;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+#include <atomic>
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Negotiates payload compression on a link. Once the link is accepted, each side announces the id of its
+		compression dictionary (0 if compression is disabled). Messages to the link are only compressed after the remote
+		announced the same id, so that it can always decompress them. Until then, they are sent uncompressed.
+	*/
+	class LinkCompression: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		LinkCompression(Link& link);
+		static EComponentType compType() { return EComponentType::LinkCompression; }
+
+		MM_TS void announce();
+		MM_TS void setRemoteId( u32 dictionaryId ) { m_RemoteId = dictionaryId; }
+		MM_TS bool isEnabled();
+
+	private:
+		atomic<u32> m_RemoteId;
+	};
+}
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "MiepMiep.h"
 #include "MasterSession.h"
 #include "Endpoint.h"
+#include "LinkCompression.h"
 
 
 namespace MiepMiep
@@ -217,6 +218,7 @@ namespace MiepMiep
 			m_WasAccepted = true;
 		}
 
+		m_Link.getOrAdd<LinkCompression>()->announce();
 		return true;
 	}
 
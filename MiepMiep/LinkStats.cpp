@@ -1,15 +1,108 @@
 #include "LinkStats.h"
+#include "Util.h"
+#include <climits>
 
 
 namespace MiepMiep
 {
 	LinkStats::LinkStats(Link& link):
 		ParentLink(link),
-		m_Latency(33),
+		m_Latency(MM_INITIAL_RTT),
+		m_RttVariance(MM_INITIAL_RTT/2),
+		m_MinRtt(UINT_MAX),
 		m_HostScore(200),
-		m_AckAggregateTime(8),
-		m_Mtu(MM_MAX_FRAGMENTSIZE),
-		m_ResendLatencyMultiplier(MM_MIN_RESEND_LATENCY_MP)
+		m_Mtu(MM_BASE_PLPMTU),
+		m_QueuedSendBytes(0),
+		m_QueuedSendPackets(0),
+		m_SendBlocked(false),
+		m_ReorderBytes(0),
+		m_RecvWindowDrops(0),
+		m_StaleDrops(0),
+		m_LossRate(0),
+		m_BytesSent(0),
+		m_BytesReceived(0),
+		m_PacketsSent(0),
+		m_PacketsReceived(0),
+		m_UncompressedBytes(0),
+		m_CompressedBytes(0),
+		m_CompressedMessages(0),
+		m_DecompressedMessages(0),
+		m_CompressMicros(0),
+		m_DecompressMicros(0),
+		m_HasRttSample(false),
+		m_Srtt((float)MM_INITIAL_RTT),
+		m_RttVar(MM_INITIAL_RTT/2.f),
+		m_RtoBackoff(0),
+		m_SentFresh(0),
+		m_SentResend(0)
 	{
+		scoped_spinlock lk(m_RttMutex);
+		updateTimers();
+	}
+
+	MM_TS void LinkStats::addRttSample( u32 rtt )
+	{
+		scoped_spinlock lk(m_RttMutex);
+		float r = (float)rtt;
+		if ( !m_HasRttSample )
+		{
+			m_Srtt   = r;
+			m_RttVar = r / 2;
+			m_HasRttSample = true;
+		}
+		else
+		{
+			float err = m_Srtt - r;
+			m_RttVar  = 0.75f * m_RttVar + 0.25f * (err < 0 ? -err : err);
+			m_Srtt	  = 0.875f * m_Srtt + 0.125f * r;
+		}
+		if ( rtt < m_MinRtt ) m_MinRtt = rtt;
+		// A valid sample means the path delivers again, so drop any backoff from previous timeouts.
+		m_RtoBackoff = 0;
+		updateTimers();
+	}
+
+	MM_TS void LinkStats::onResendTimeout()
+	{
+		scoped_spinlock lk(m_RttMutex);
+		if ( m_RtoBackoff < MM_MAX_RTO_BACKOFF )
+		{
+			m_RtoBackoff++;
+			updateTimers();
+		}
+	}
+
+	MM_TS void LinkStats::addSentPacket( bool isResend )
+	{
+		scoped_spinlock lk(m_LossMutex);
+		(isResend ? m_SentResend : m_SentFresh)++;
+		if ( m_SentFresh + m_SentResend < MM_LOSS_SAMPLE_PACKETS )
+			return;
+		float sample = Util::min( (float)m_SentResend / Util::max( m_SentFresh, (u32)1 ), 1.f );
+		// Rise fast, decay slow. Forward error correction hides the loss it repairs from this estimate,
+		// so a slow decay keeps it from switching off right after it starts to work.
+		float loss = m_LossRate;
+		m_LossRate = sample > loss ? 0.5f * loss + 0.5f * sample : 0.97f * loss + 0.03f * sample;
+		m_SentFresh  = 0;
+		m_SentResend = 0;
+	}
+
+	// NOTE: Requires rtt lock.
+	void LinkStats::updateTimers()
+	{
+		u32 srtt   = u32( m_Srtt + .5f );
+		u32 rttVar = u32( m_RttVar + .5f );
+
+		// Aggregate acks for a fraction of the rtt. The delay is echoed back and subtracted from samples on the remote,
+		// but it still postpones the ack, so the resend timeout must account for it.
+		u32 ackTime = Util::min( Util::max( srtt/4, (u32)MM_MIN_ACK_AGGREGATE_TIME ), (u32)MM_MAX_ACK_AGGREGATE_TIME );
+		u32 rto = srtt + Util::max( 4*rttVar, (u32)MM_RTT_GRANULARITY ) + ackTime;
+		rto = Util::min( Util::max( rto, (u32)MM_MIN_RTO ) << m_RtoBackoff, (u32)MM_MAX_RTO );
+
+		m_Latency	  = srtt;
+		m_RttVariance = rttVar;
+		m_AckAggregateTime = ackTime;
+		m_ResendDelay = rto;
+		m_RtoBackoffShared = m_RtoBackoff;
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Component.h"
 #include "Memory.h"
 #include "ParentLink.h"
+#include "Threading.h"
 #include <atomic>
 
 
@@ -17,24 +18,108 @@ namespace MiepMiep
 		LinkStats(Link& link);
 		static EComponentType compType() { return EComponentType::LinkStats; }
 
-		// TODO
-		MM_TS u32 latency() const		{ return m_Latency; }
-		MM_TS u32 mtu()  const			{ return m_Mtu; }
+		// Round trip times in ms, maintained by a Jacobson/Karels estimator (RFC 6298).
+		MM_TS u32 latency() const		{ return m_Latency; }		// Smoothed RTT
+		MM_TS u32 rttVariance() const	{ return m_RttVariance; }
+		MM_TS u32 minRtt() const		{ return m_MinRtt; }
+		MM_TS u32 mtu()  const			{ return m_Mtu; }		// Confirmed path mtu (udp payload size), see MtuDiscovery
 		MM_TS u32 hostScore() const		{ return m_HostScore; }
 
-		float resendLatencyMultiplier() const		{ return m_ResendLatencyMultiplier; }
-		u32 reliableResendDelay() const				{ return u32(latency() * resendLatencyMultiplier()); }
-		u32 ackAggregateTime() const				{ return m_AckAggregateTime; }
-		u32 mtuAdjusted() const						{ return u32( mtu()*0.8f ); }
+		MM_TS u32 reliableResendDelay() const		{ return m_ResendDelay; }
+		MM_TS u32 ackAggregateTime() const			{ return m_AckAggregateTime; }
+		MM_TS u32 rtoBackoff() const				{ return m_RtoBackoffShared; }
+		MM_TS u32 mtuAdjusted() const				{ return u32( mtu()*0.8f ); }
+		MM_TS float lossRate() const				{ return m_LossRate; } // Fraction of reliable packets that needed a resend
 
 		// Stat updates
-		// MM_TS updateReliableSendQueueLength( u32 size );
+		MM_TS void addRttSample( u32 rtt );
+		MM_TS void onResendTimeout();
+		MM_TS void addSentPacket( bool isResend );
+		MM_TS void setMtu( u32 mtu )				{ m_Mtu = mtu; }
+
+		// Reliable data queued and not yet acked, summed over all channels.
+		MM_TS u32 queuedSendBytes() const			{ return m_QueuedSendBytes; }
+		MM_TS u32 queuedSendPackets() const			{ return m_QueuedSendPackets; }
+		MM_TS void addQueuedSend( u32 bytes, u32 packets )		{ m_QueuedSendBytes += bytes; m_QueuedSendPackets += packets; }
+		MM_TS void removeQueuedSend( u32 bytes, u32 packets )	{ m_QueuedSendBytes -= bytes; m_QueuedSendPackets -= packets; }
+
+		// Out of order reliable data held until the packets before it arrive, summed over all channels.
+		MM_TS u32 reorderBytes() const				{ return m_ReorderBytes; }
+		MM_TS u32 recvWindowDrops() const			{ return m_RecvWindowDrops; }
+		MM_TS void addReorderBytes( u32 bytes )		{ m_ReorderBytes += bytes; }
+		MM_TS void removeReorderBytes( u32 bytes )	{ m_ReorderBytes -= bytes; }
+		MM_TS void addRecvWindowDrop()				{ m_RecvWindowDrops++; }
+
+		// Unreliable sequenced packets that arrived after a newer one.
+		MM_TS u32 staleDrops() const				{ return m_StaleDrops; }
+		MM_TS void addStaleDrop()					{ m_StaleDrops++; }
+
+		// Udp payloads sent to and received from this link, including headers, acks and resends.
+		MM_TS u64 bytesSent() const					{ return m_BytesSent; }
+		MM_TS u64 bytesReceived() const				{ return m_BytesReceived; }
+		MM_TS u64 packetsSent() const				{ return m_PacketsSent; }
+		MM_TS u64 packetsReceived() const			{ return m_PacketsReceived; }
+		MM_TS void addSentBytes( u32 bytes )		{ m_BytesSent += bytes; m_PacketsSent++; }
+		MM_TS void addReceivedBytes( u32 bytes )	{ m_BytesReceived += bytes; m_PacketsReceived++; }
+
+		// Compressed messages, see INetwork::setCompression. Sizes are message payloads, times are cpu microseconds.
+		MM_TS u64 uncompressedBytes() const			{ return m_UncompressedBytes; }
+		MM_TS u64 compressedBytes() const			{ return m_CompressedBytes; }
+		MM_TS u32 compressedMessages() const		{ return m_CompressedMessages; }
+		MM_TS u32 decompressedMessages() const		{ return m_DecompressedMessages; }
+		MM_TS u64 compressMicros() const			{ return m_CompressMicros; }
+		MM_TS u64 decompressMicros() const			{ return m_DecompressMicros; }
+		MM_TS void addCompressed( u32 originalSize, u32 compressedSize, u32 micros )
+		{
+			m_UncompressedBytes += originalSize; m_CompressedBytes += compressedSize; m_CompressedMessages++; m_CompressMicros += micros;
+		}
+		MM_TS void addDecompressed( u32 micros )	{ m_DecompressedMessages++; m_DecompressMicros += micros; }
+
+		// Set when a send to this link returned WouldBlock, cleared by the one that reports the drained queue.
+		MM_TS void setSendBlocked()					{ m_SendBlocked = true; }
+		MM_TS bool isSendBlocked() const			{ return m_SendBlocked; }
+		MM_TS bool clearSendBlocked()				{ return m_SendBlocked.exchange( false ); }
+
+	private:
+		void updateTimers();
 
 	private:
 		atomic<u32> m_Latency;
+		atomic<u32> m_RttVariance;
+		atomic<u32> m_MinRtt;
 		atomic<u32> m_Mtu;
 		atomic<u32> m_HostScore;
+		atomic<u32> m_ResendDelay;
 		atomic<u32> m_AckAggregateTime;
-		float m_ResendLatencyMultiplier;
+		atomic<u32> m_RtoBackoffShared;
+		atomic<u32> m_QueuedSendBytes;
+		atomic<u32> m_QueuedSendPackets;
+		atomic<bool> m_SendBlocked;
+		atomic<u32> m_ReorderBytes;
+		atomic<u32> m_RecvWindowDrops;
+		atomic<u32> m_StaleDrops;
+		atomic<float> m_LossRate;
+		atomic<u64> m_BytesSent;
+		atomic<u64> m_BytesReceived;
+		atomic<u64> m_PacketsSent;
+		atomic<u64> m_PacketsReceived;
+		atomic<u64> m_UncompressedBytes;
+		atomic<u64> m_CompressedBytes;
+		atomic<u32> m_CompressedMessages;
+		atomic<u32> m_DecompressedMessages;
+		atomic<u64> m_CompressMicros;
+		atomic<u64> m_DecompressMicros;
+
+		// Estimator state, only accessed with the rtt lock held.
+		SpinLock m_RttMutex;
+		bool  m_HasRttSample;
+		float m_Srtt;
+		float m_RttVar;
+		u32   m_RtoBackoff;
+
+		// Loss sample state, only accessed with the loss lock held.
+		SpinLock m_LossMutex;
+		u32   m_SentFresh;
+		u32   m_SentResend;
 	};
-}
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "Lz.h"
+#include "Util.h"
+#include <cstring>
+
+
+namespace MiepMiep
+{
+	static u32 read32( const byte* p )
+	{
+		u32 v;
+		memcpy( &v, p, 4 );
+		return v;
+	}
+
+	static u32 lzHash( const byte* p )
+	{
+		return (read32( p ) * 2654435761U) >> (32 - MM_LZ_HASH_BITS);
+	}
+
+	static bool writeLength( byte*& op, const byte* opEnd, u32 len )
+	{
+		while ( len >= 255 )
+		{
+			if ( op == opEnd ) return false;
+			*op++ = 255;
+			len -= 255;
+		}
+		if ( op == opEnd ) return false;
+		*op++ = (byte)len;
+		return true;
+	}
+
+	static bool readLength( const byte*& ip, const byte* ipEnd, u32& len )
+	{
+		byte b;
+		do
+		{
+			if ( ip == ipEnd ) return false;
+			b = *ip++;
+			len += b;
+		} while ( b == 255 );
+		return true;
+	}
+
+	static bool writeSequence( byte*& op, const byte* opEnd, const byte* literals, u32 numLiterals, u32 offset, u32 matchLen )
+	{
+		if ( op == opEnd ) return false;
+		byte* token = op++;
+		*token = (byte)(Util::min( numLiterals, (u32)15 ) << 4);
+		if ( numLiterals >= 15 && !writeLength( op, opEnd, numLiterals - 15 ) ) return false;
+		if ( (u32)(opEnd - op) < numLiterals ) return false;
+		memcpy( op, literals, numLiterals );
+		op += numLiterals;
+		if ( matchLen == 0 )
+			return true; // Last sequence.
+		if ( opEnd - op < 2 ) return false;
+		*op++ = (byte)offset;
+		*op++ = (byte)(offset >> 8);
+		u32 ml = matchLen - MM_LZ_MIN_MATCH;
+		*token |= (byte)Util::min( ml, (u32)15 );
+		if ( ml >= 15 && !writeLength( op, opEnd, ml - 15 ) ) return false;
+		return true;
+	}
+
+
+	// --- LzDictionary ------------------------------------------------------------------------------------------
+
+	LzDictionary::LzDictionary(const byte* data, u32 size):
+		m_Table(1 << MM_LZ_HASH_BITS, 0),
+		m_Id(2166136261U)
+	{
+		for ( u32 i=0; i<size; ++i )
+		{
+			m_Id = (m_Id ^ data[i]) * 16777619U;
+		}
+		if ( size > MM_LZ_MAX_OFFSET )
+		{
+			data += size - MM_LZ_MAX_OFFSET;
+			size  = MM_LZ_MAX_OFFSET;
+		}
+		m_Data.assign( data, data + size );
+		for ( u32 i=0; i+MM_LZ_MIN_MATCH <= size; ++i )
+		{
+			m_Table[ lzHash( data + i ) ] = i+1;
+		}
+	}
+
+
+	// --- Lz ------------------------------------------------------------------------------------------
+
+	u32 Lz::compress( const byte* src, u32 srcLen, const LzDictionary* dict, byte* dst, u32 dstCapacity )
+	{
+		if ( dstCapacity < 4 )
+			return 0;
+		dst[0] = (byte)(srcLen >> 24);
+		dst[1] = (byte)(srcLen >> 16);
+		dst[2] = (byte)(srcLen >> 8);
+		dst[3] = (byte)srcLen;
+		byte* op = dst + 4;
+		const byte* opEnd = dst + dstCapacity;
+
+		thread_local static vector<u32> table;
+		table.assign( 1 << MM_LZ_HASH_BITS, 0 );
+		u32 dictLen = dict ? (u32)dict->m_Data.size() : 0;
+
+		u32 anchor = 0;
+		u32 i = 0;
+		while ( i + MM_LZ_MIN_MATCH <= srcLen )
+		{
+			u32 h = lzHash( src + i );
+			u32 offset   = 0;
+			u32 matchLen = 0;
+
+			u32 cand = table[h];
+			table[h] = i+1;
+			if ( cand != 0 && i - (cand-1) <= MM_LZ_MAX_OFFSET && read32( src + cand-1 ) == read32( src + i ) )
+			{
+				u32 ref = cand-1;
+				matchLen = MM_LZ_MIN_MATCH;
+				while ( i + matchLen < srcLen && src[ref + matchLen] == src[i + matchLen] ) matchLen++;
+				offset = i - ref;
+			}
+			else if ( dict )
+			{
+				u32 dcand = dict->m_Table[h];
+				if ( dcand != 0 )
+				{
+					u32 ref = dcand-1;
+					u32 dictOffset = i + (dictLen - ref);
+					if ( dictOffset <= MM_LZ_MAX_OFFSET && ref + MM_LZ_MIN_MATCH <= dictLen && read32( dict->m_Data.data() + ref ) == read32( src + i ) )
+					{
+						// Matches end at the end of the dictionary.
+						matchLen = MM_LZ_MIN_MATCH;
+						while ( i + matchLen < srcLen && ref + matchLen < dictLen && dict->m_Data[ref + matchLen] == src[i + matchLen] ) matchLen++;
+						offset = dictOffset;
+					}
+				}
+			}
+
+			if ( matchLen == 0 )
+			{
+				i++;
+				continue;
+			}
+			if ( !writeSequence( op, opEnd, src + anchor, i - anchor, offset, matchLen ) )
+				return 0;
+			i += matchLen;
+			anchor = i;
+		}
+		if ( !writeSequence( op, opEnd, src + anchor, srcLen - anchor, 0, 0 ) )
+			return 0;
+		return (u32)(op - dst);
+	}
+
+	u32 Lz::originalSize( const byte* src, u32 srcLen )
+	{
+		if ( srcLen < 5 )
+			return 0;
+		return ((u32)src[0] << 24) | ((u32)src[1] << 16) | ((u32)src[2] << 8) | src[3];
+	}
+
+	bool Lz::decompress( const byte* src, u32 srcLen, const LzDictionary* dict, byte* dst, u32 dstLen )
+	{
+		// Also reject a truncated header, originalSize returns 0 for it which matches an empty message.
+		if ( srcLen < 5 || originalSize( src, srcLen ) != dstLen )
+			return false;
+		const byte* ip = src + 4;
+		const byte* ipEnd = src + srcLen;
+		u32 o = 0;
+		u32 dictLen = dict ? (u32)dict->m_Data.size() : 0;
+		while ( true )
+		{
+			if ( ip == ipEnd ) return false;
+			byte token = *ip++;
+			u32 numLiterals = token >> 4;
+			if ( numLiterals == 15 && !readLength( ip, ipEnd, numLiterals ) ) return false;
+			if ( (u32)(ipEnd - ip) < numLiterals || dstLen - o < numLiterals ) return false;
+			memcpy( dst + o, ip, numLiterals );
+			ip += numLiterals;
+			o  += numLiterals;
+			if ( ip == ipEnd )
+				return o == dstLen; // Last sequence.
+
+			if ( ipEnd - ip < 2 ) return false;
+			u32 offset = ip[0] | ((u32)ip[1] << 8);
+			ip += 2;
+			u32 matchLen = token & 15;
+			if ( matchLen == 15 && !readLength( ip, ipEnd, matchLen ) ) return false;
+			matchLen += MM_LZ_MIN_MATCH;
+			if ( offset == 0 || offset > o + dictLen || dstLen - o < matchLen ) return false;
+
+			// The match may start in the dictionary, overlap the boundary, or overlap itself.
+			for ( u32 k=0; k<matchLen; ++k, ++o )
+			{
+				dst[o] = offset > o ? dict->m_Data[dictLen - (offset - o)] : dst[o - offset];
+			}
+		}
+	}
+}
\ No newline at end of file
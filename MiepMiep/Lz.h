@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+#include <vector>
+
+
+namespace MiepMiep
+{
+	/*
+		Dictionary that is logically placed in front of every message, so that even the first bytes of a small message
+		can refer to it. Train it offline from captured traffic: put the most common byte strings (rpc names, meta data keys)
+		at the end, as these get the smallest offsets. Only the last MM_LZ_MAX_OFFSET bytes are used.
+	*/
+	struct LzDictionary
+	{
+		LzDictionary(const byte* data, u32 size);
+
+		vector<byte> m_Data;
+		vector<u32>  m_Table; // Hash of 4 bytes -> last position+1 in the dictionary, 0 if none.
+		u32 m_Id;			  // FNV-1a hash of the data, both sides must have the same.
+	};
+
+
+	/*
+		Fast LZ77 codec for small messages, in the spirit of LZ4.
+		[ originalLength(4) | sequences ], each sequence is:
+		[ token(1): literals(4 bits) matchLength-4(4 bits) | <extra literal length> | literals | offset(2) | <extra match length> ]
+		A length of 15 continues in following bytes, each adding up to 255. The last sequence has only literals.
+	*/
+	struct Lz
+	{
+		// Returns the compressed size, or 0 if it does not fit in 'dstCapacity'.
+		static u32 compress( const byte* src, u32 srcLen, const LzDictionary* dict, byte* dst, u32 dstCapacity );
+		// Returns the original size as stored in the compressed data, 0 if it is invalid.
+		static u32 originalSize( const byte* src, u32 srcLen );
+		// 'dst' must hold 'originalSize' bytes. Returns false if the data is corrupt.
+		static bool decompress( const byte* src, u32 srcLen, const LzDictionary* dict, byte* dst, u32 dstLen );
+	};
+}
\ No newline at end of file
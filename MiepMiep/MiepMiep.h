@@ -2,6 +2,7 @@
 
 #include "Variables.h"
 #include "Rpc.h"
+#include "BitSerializer.h"
 #include <string>
 #include <vector>
 
@@ -13,6 +14,7 @@ namespace MiepMiep
 	enum class EPacketType : byte
 	{
 		RPC,
+		Stream,
 		UserOffsetStart
 	};
 
@@ -70,7 +72,22 @@ namespace MiepMiep
 		NotSent,
 		/*	See log for more info. */
 		SerializationError,
-		InternalError
+		InternalError,
+		/*	Queueing the packet would exceed the send queue limits of a link or session, see INetwork::setSendQueueLimits.
+			Nothing was queued to any link. ISessionListener::onSendQueueDrained is called when a blocked link can send again. */
+		WouldBlock,
+		/*	Unreliable and reliable newest messages are not fragmented and must fit in the path mtu of every link they go to.
+			Nothing was sent. */
+		TooBig
+	};
+
+	enum class EFecMode : byte
+	{
+		None,
+		/*	One parity packet per group, recovers a single lost packet. Low overhead. */
+		Xor,
+		/*	Multiple parity packets per group, recovers as many lost packets as there are parity packets. */
+		ReedSolomon
 	};
 
 
@@ -83,6 +100,12 @@ namespace MiepMiep
 	};
 
 
+	/*	Provides the data of a stream, see INetwork::sendStream. Write at most 'size' bytes to 'buffer' and return the number
+		of bytes written. Return 0 once all data was provided, which ends the stream. Called from a worker thread of the network,
+		for one chunk at a time. A slow reader only delays its own stream, but does occupy a worker while it blocks. */
+	using StreamReader = std::function<u32 ( byte* buffer, u32 size )>;
+
+
 	class MM_DECLSPEC ISessionListener
 	{
 	public:
@@ -92,6 +115,13 @@ namespace MiepMiep
 		virtual void onNewHost( ISession& session, const IAddress* host ) { }
 		virtual void onLostHost( ISession& session ) { }
 		virtual void onLostMasterLink( ISession& session, const ILink& link ) { }
+		/*	Called once for each link that was part of a send that returned ESendCallResult::WouldBlock, as soon as
+			its send queue drained to half its limits (or is empty when only session limits are set). */
+		virtual void onSendQueueDrained( ISession& session, const ILink& link ) { }
+		/*	A chunk of a stream sent with INetwork::sendStream arrived, chunks arrive in order. 'offset' is the position of the
+			chunk in the stream. The last call has 'isLast' set and may have no data. For streams that are written to a file
+			(see INetwork::receiveStreamToFile), only the last call is made, without data. */
+		virtual void onStreamData( ISession& session, const ILink& link, u32 streamId, u64 offset, const byte* data, u32 size, bool isLast ) { }
 	};
 
 
@@ -146,17 +176,30 @@ namespace MiepMiep
 		MM_TS virtual const IAddress& source() const=0;
 		MM_TS virtual bool  isConnected() const=0;
 
+		/*	Reliable data that is queued on this link and not yet acknowledged. */
+		MM_TS virtual u32 queuedSendBytes() const=0;
+		MM_TS virtual u32 queuedSendPackets() const=0;
+
+		template <typename T, typename ...Args>
+		MM_TS ESendCallResult callRpc( const Args&... args, bool localCall=false, bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr );
+
 		template <typename T, typename ...Args>
-		MM_TS ESendCallResult callRpc( Args... args, bool localCall=false, bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr );
+		MM_TS ESendCallResult callRpcUnreliable( const Args&... args, bool localCall=false, bool relay=false, byte channel=0 );
 
 		MM_TS sptr<ILink> to_ptr();
 		MM_TS sptr<const ILink> to_ptr() const;
 	};
 
 	template <typename T, typename ...Args>
-	MM_TS ESendCallResult ILink::callRpc( Args... args, bool localCall, bool relay, byte channel, IDeliveryTrace* trace )
+	MM_TS ESendCallResult ILink::callRpc( const Args&... args, bool localCall, bool relay, byte channel, IDeliveryTrace* trace )
 	{
-		return network().callRpc<Args...>( args..., nullptr, this, localCall, No_Buffer, relay, channel, trace );
+		return network().callRpc<T, Args...>( args..., nullptr, this, localCall, No_Buffer, relay, channel, trace );
+	}
+
+	template <typename T, typename ...Args>
+	MM_TS ESendCallResult ILink::callRpcUnreliable( const Args&... args, bool localCall, bool relay, byte channel )
+	{
+		return network().callRpcUnreliable<T, Args...>( args..., nullptr, this, localCall, relay, channel );
 	}
 
 
@@ -179,19 +222,28 @@ namespace MiepMiep
 
 
 		template <typename T, typename ...Args>
-		MM_TS ESendCallResult callRpc( Args... args, ILink* exclOrSpecific=nullptr, bool localCall=false, bool buffer=false,
+		MM_TS ESendCallResult callRpc( const Args&... args, ILink* exclOrSpecific=nullptr, bool localCall=false, bool buffer=false,
 									   bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr );
 
+		template <typename T, typename ...Args>
+		MM_TS ESendCallResult callRpcUnreliable( const Args&... args, ILink* exclOrSpecific=nullptr, bool localCall=false, bool relay=false, byte channel=0 );
+
 		MM_TS sptr<ISession> to_ptr();
 		MM_TS sptr<const ISession> to_ptr() const;
 	};
 
 	template <typename T, typename ...Args>
-	MM_TS ESendCallResult ISession::callRpc( Args... args, ILink* exclOrSpecific, bool localCall, bool buffer, bool relay, byte channel, IDeliveryTrace* trace )
+	MM_TS ESendCallResult ISession::callRpc( const Args&... args, ILink* exclOrSpecific, bool localCall, bool buffer, bool relay, byte channel, IDeliveryTrace* trace )
 	{
 		return network().callRpc<T, Args...>( args..., this, exclOrSpecific, localCall, buffer, relay, channel, trace );
 	}
 
+	template <typename T, typename ...Args>
+	MM_TS ESendCallResult ISession::callRpcUnreliable( const Args&... args, ILink* exclOrSpecific, bool localCall, bool relay, byte channel )
+	{
+		return network().callRpcUnreliable<T, Args...>( args..., this, exclOrSpecific, localCall, relay, channel );
+	}
+
 
 	class MM_DECLSPEC INetwork
 	{
@@ -223,11 +275,19 @@ namespace MiepMiep
 		MM_TS virtual bool disconnectAll()=0;
 
 		template <typename T, typename ...Args>
-		MM_TS ESendCallResult callRpc( Args... args, const ISession* session, ILink* exclOrSpecific=nullptr, bool localCall=false, bool buffer=false,
+		MM_TS ESendCallResult callRpc( const Args&... args, const ISession* session, ILink* exclOrSpecific=nullptr, bool localCall=false, bool buffer=false,
 									   bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr );
 
+		/*	Unreliable sequenced rpc. It may be lost and it is dropped if a newer message on the same channel arrived first.
+			Use it for state that is sent repeatedly, such as positions. The message cannot be buffered and must fit in a
+			single packet, otherwise ESendCallResult::TooBig is returned. Unreliable messages on a channel are sent before
+			reliable ones. */
 		template <typename T, typename ...Args>
-		MM_TS ECreateGroupCallResult createGroup( Args&&... args, const ISession& session, bool localCall=false, byte channel=0, IDeliveryTrace* trace=nullptr );
+		MM_TS ESendCallResult callRpcUnreliable( const Args&... args, const ISession* session, ILink* exclOrSpecific=nullptr, bool localCall=false,
+												 bool relay=false, byte channel=0 );
+
+		template <typename T, typename ...Args>
+		MM_TS ECreateGroupCallResult createGroup( const Args&... args, const ISession& session, bool localCall=false, byte channel=0, IDeliveryTrace* trace=nullptr );
 		MM_TS virtual void destroyGroup( u32 groupId )=0;
 
 		MM_TS virtual void addSessionListener( ISession& session, ISessionListener* sessionListener )=0;
@@ -235,25 +295,90 @@ namespace MiepMiep
 
 		MM_TS virtual ESendCallResult sendReliable( byte id, const ISession* session, ILink* exclOrSpecific, const BinSerializer* serializers, u32 numSerializers=1,
 													bool buffer=false, bool relay=false, byte channel=0, IDeliveryTrace* trace=nullptr )=0;
+		MM_TS virtual ESendCallResult sendUnreliable( byte id, const ISession* session, ILink* exclOrSpecific, const BinSerializer* serializers, u32 numSerializers=1,
+													  bool relay=false, byte channel=0 )=0;
+
+		/*	Reliable newest: Only the latest message per 'key' on a channel is delivered. A newer message for the same key
+			supersedes an older one that is not acked yet, which is then never resent. Use it for state of which only the latest
+			value matters, such as variables of a group. Messages of different keys are not ordered and must fit in a single packet. */
+		MM_TS virtual ESendCallResult sendReliableNewest( byte id, u32 key, const ISession* session, ILink* exclOrSpecific, const BinSerializer* serializers,
+														  u32 numSerializers=1, bool relay=false, byte channel=0 )=0;
+
+		/*	Streams a large message, such as a level or replay, to a link. The data is pulled from 'reader' in chunks of one packet,
+			only while the channel has less than MM_STREAM_WINDOW packets unacked, so memory stays bounded regardless of the size.
+			The remote receives the chunks through ISessionListener::onStreamData. Messages sent on the same channel after the
+			stream started may arrive before the end of the stream. The channel must be ordered. */
+		MM_TS virtual ESendCallResult sendStream( ILink& link, u32 streamId, const StreamReader& reader, byte channel=0 )=0;
+		/*	Same as above, reading from the file at 'filePath'. Returns NotSent if the file cannot be opened. */
+		MM_TS virtual ESendCallResult sendStreamFile( ILink& link, u32 streamId, const std::string& filePath, byte channel=0 )=0;
+		/*	Incoming streams with 'streamId' from 'link' are written to 'filePath' instead of passed to ISessionListener::onStreamData.
+			Stream ids are only unique per link, so each link needs its own file. Applies to all streams with that id from the link
+			that start afterwards, until cleared with an empty path. */
+		MM_TS virtual void receiveStreamToFile( ILink& link, u32 streamId, const std::string& filePath )=0;
 
 		MM_TS static void setLogSettings( bool logToFile=true, bool logToIde=true );
 
 		/* Value between 0 and 100. Default is 0. */
 		MM_TS virtual void simulatePacketLoss( u32 percentage )=0;
+
+		/*	Channels in a higher priority class (lower number) are always sent first. A channel in a lower class only sends
+			when all channels in higher classes have nothing to send. Within a class, the bandwidth is shared in proportion
+			to the weight of each channel. Default is class 0 with weight 1 for all channels.
+			Example: Put gameplay on channel 0 in class 0 and a bulk transfer on channel 5 in class 1, so that the transfer
+			never delays gameplay messages. */
+		MM_TS virtual void setChannelPriority( byte channel, u32 priorityClass, u32 weight=1 )=0;
+
+		/*	Reliable messages on an unordered channel are handled as soon as they arrive (and all their fragments),
+			so a lost packet does not hold back the messages sent after it. Messages are still delivered exactly once.
+			Use it for independent events, such as hit notifications. Default is ordered for all channels.
+			The setting applies to messages sent after the call, the remote needs no configuration. */
+		MM_TS virtual void setChannelOrdered( byte channel, bool ordered )=0;
+
+		/*	Forward error correction for the reliable messages of a channel. Parity packets are sent along, from which the
+			remote rebuilds lost packets without waiting for a resend. The protection follows the measured loss of each link,
+			no parity is sent on links without loss. Default is EFecMode::None for all channels. */
+		MM_TS virtual void setChannelFec( byte channel, EFecMode mode )=0;
+
+		/*	Maximum number of bytes per second each link sends. Channel priorities only matter when a link is limited.
+			Default is 0, which is unlimited. */
+		MM_TS virtual void setLinkSendRate( u32 bytesPerSecond )=0;
+
+		/*	Limits the amount of reliable data that is queued and not yet acknowledged, per link and per session (summed over
+			all its links). A send that would exceed any limit of a link it goes to, or of its session, is not queued at all and
+			returns ESendCallResult::WouldBlock. Use this to shed load or disconnect a client that stopped acknowledging.
+			The limits are checked before queueing, so concurrent sends from different threads may exceed them slightly.
+			Default is 0 for all, which is unlimited. */
+		MM_TS virtual void setSendQueueLimits( u32 maxLinkBytes, u32 maxLinkPackets, u32 maxSessionBytes=0, u32 maxSessionPackets=0 )=0;
+
+		/*	Compresses message payloads with a fast LZ codec. The optional dictionary is trained offline from captured traffic
+			(for example the rpc names and meta data keys that are sent most) and is copied. Messages to a link are only compressed
+			if both sides enabled compression with the same dictionary, which is checked per link when it connects, so call this
+			before connecting or listening. Messages that do not shrink by at least a few bytes are sent uncompressed.
+			Default is disabled. */
+		MM_TS virtual void setCompression( bool enable, const byte* dictionary=nullptr, u32 size=0 )=0;
 	};
 
 
 	template <typename T, typename ...Args>
-	MM_TS ESendCallResult INetwork::callRpc( Args... args, const ISession* session, ILink* exclOrSpecific, bool localCall,
+	MM_TS ESendCallResult INetwork::callRpc( const Args&... args, const ISession* session, ILink* exclOrSpecific, bool localCall,
 											 bool buffer, bool relay, byte channel, IDeliveryTrace* trace )
 	{
 		auto& bs=priv_get_thread_serializer();
 		T::rpc<Args...>( args..., *this, bs, localCall, channel );
-		return priv_send_rpc( *this, T::rpcName(), bs, session, exclOrSpecific, buffer, relay, false, channel, trace );
+		return priv_send_rpc( *this, T::rpcHeader(), bs, session, exclOrSpecific, buffer, relay, false, channel, trace );
+	}
+
+	template <typename T, typename ...Args>
+	MM_TS ESendCallResult INetwork::callRpcUnreliable( const Args&... args, const ISession* session, ILink* exclOrSpecific, bool localCall,
+													   bool relay, byte channel )
+	{
+		auto& bs=priv_get_thread_serializer();
+		T::rpc<Args...>( args..., *this, bs, localCall, channel );
+		return priv_send_rpc_unreliable( *this, T::rpcHeader(), bs, session, exclOrSpecific, relay, false, channel );
 	}
 
 	template <typename T, typename ...Args>
-	MM_TS ECreateGroupCallResult INetwork::createGroup( Args&&... args, const ISession& session, bool localCall, byte channel, IDeliveryTrace* trace )
+	MM_TS ECreateGroupCallResult INetwork::createGroup( const Args&... args, const ISession& session, bool localCall, byte channel, IDeliveryTrace* trace )
 	{
 		auto& bs=priv_get_thread_serializer();
 		T::rpc<Args...>( args..., *this, bs, localCall, channel );
@@ -0,0 +1,156 @@
+#include "MtuDiscovery.h"
+#include "Link.h"
+#include "LinkStats.h"
+#include "PacketHelper.h"
+#include "PerThreadDataProvider.h"
+#include "Socket.h"
+#include "Util.h"
+
+
+namespace MiepMiep
+{
+	static const byte s_ProbePadding[MM_MAX_PLPMTU] = { 0 };
+
+
+	MtuDiscovery::MtuDiscovery(Link& link):
+		ParentLink(link),
+		m_Confirmed(MM_BASE_PLPMTU),
+		m_Failed(MM_MAX_PLPMTU+1),
+		m_ProbeSize(0),
+		m_ProbeId(0),
+		m_ProbeCount(0),
+		m_ProbeSendTS(0),
+		m_RaiseTS(0)
+	{
+	}
+
+	MM_TS void MtuDiscovery::intervalDispatch( u64 time )
+	{
+		if ( !m_Link.isConnected() )
+			return;
+
+		auto stats = m_Link.getOrAdd<LinkStats>();
+		scoped_lock lk( m_Mutex );
+
+		// Black hole detection: If reliable data keeps timing out at maximum backoff, the path may no longer
+		// carry the confirmed size. Fall back to the base size and search again.
+		if ( m_Confirmed > MM_BASE_PLPMTU && stats->rtoBackoff() >= MM_MAX_RTO_BACKOFF )
+		{
+			LOG( "Link %s suspects path mtu black hole, falling back to %d bytes.", m_Link.info(), MM_BASE_PLPMTU );
+			m_Failed	= m_Confirmed;
+			m_ProbeSize = 0;
+			m_RaiseTS	= 0;
+			setConfirmed( MM_BASE_PLPMTU );
+		}
+
+		if ( m_ProbeSize != 0 )
+		{
+			if ( time - m_ProbeSendTS < stats->reliableResendDelay() )
+				return;
+			if ( m_ProbeCount < MM_PMTU_MAX_PROBES )
+			{
+				sendProbe( time );
+				return;
+			}
+			onProbeFailed();
+		}
+
+		if ( m_Failed - m_Confirmed <= MM_PMTU_SEARCH_ACCURACY )
+		{
+			// Search complete, try a larger size again after a while as the path may have changed.
+			if ( m_RaiseTS == 0 )
+			{
+				m_RaiseTS = time + MM_PMTU_RAISE_TIMER;
+			}
+			if ( time < m_RaiseTS )
+				return;
+			m_RaiseTS = 0;
+			m_Failed  = MM_MAX_PLPMTU+1;
+			if ( m_Failed - m_Confirmed <= MM_PMTU_SEARCH_ACCURACY )
+				return;
+		}
+
+		m_ProbeSize  = nextProbeSize();
+		m_ProbeCount = 0;
+		sendProbe( time );
+	}
+
+	MM_TS void MtuDiscovery::receive( BinSerializer& bs, const PacketInfo& pi )
+	{
+		byte kind;
+		__CHECKED( bs.read( kind ) );
+
+		switch ( (EProbeKind)kind )
+		{
+		case EProbeKind::Probe:
+		{
+			// Echo the probe id and the size that actually arrived.
+			auto& ackBs = PerThreadDataProvider::getSerializer( true );
+			__CHECKED( PacketHelper::beginUnfragmented( ackBs, pi.m_Sequence, (byte)compType(), InvalidByte, 0, No_Relay, Do_SysBit ) );
+			__CHECKED( ackBs.write( (byte)EProbeKind::Ack ) );
+			__CHECKED( ackBs.write( (u16)bs.length() ) );
+			m_Link.send( ackBs.data(), ackBs.length() );
+		}
+		break;
+
+		case EProbeKind::Ack:
+		{
+			u16 size;
+			__CHECKED( bs.read( size ) );
+			scoped_lock lk( m_Mutex );
+			if ( m_ProbeSize != 0 && pi.m_Sequence == m_ProbeId && size == m_ProbeSize )
+			{
+				setConfirmed( m_ProbeSize );
+				m_ProbeSize = 0;
+			}
+		}
+		break;
+
+		default:
+			LOGW( "Unknown mtu probe kind %d.", (u32)kind );
+			break;
+		}
+	}
+
+	u32 MtuDiscovery::nextProbeSize() const
+	{
+		// Most paths support the ethernet mtu, so try it before bisecting.
+		u32 common = m_Link.socket().getIpProtocol() == IPProto::Ipv4 ? MM_COMMON_PLPMTU_IPV4 : MM_COMMON_PLPMTU_IPV6;
+		if ( common > m_Confirmed && common < m_Failed )
+		{
+			return common;
+		}
+		return m_Confirmed + (m_Failed - m_Confirmed) / 2;
+	}
+
+	void MtuDiscovery::sendProbe( u64 time )
+	{
+		m_ProbeId++;
+		m_ProbeCount++;
+		m_ProbeSendTS = time;
+
+		// [ probeId(4) | compType(1) | channelAndFlags(1) | kind(1) | padding up to probe size ]
+		auto& bs = PerThreadDataProvider::getSerializer( true );
+		__CHECKED( PacketHelper::beginUnfragmented( bs, m_ProbeId, (byte)compType(), InvalidByte, 0, No_Relay, Do_SysBit ) );
+		__CHECKED( bs.write( (byte)EProbeKind::Probe ) );
+		__CHECKED( bs.write( s_ProbePadding, m_ProbeSize - bs.length() ) );
+
+		if ( ESendResult::MessageTooBig == m_Link.send( bs.data(), bs.length() ) )
+		{
+			// The local interface already rejects this size, no need to wait for a timeout.
+			onProbeFailed();
+		}
+	}
+
+	void MtuDiscovery::onProbeFailed()
+	{
+		m_Failed	= m_ProbeSize;
+		m_ProbeSize = 0;
+	}
+
+	void MtuDiscovery::setConfirmed( u32 size )
+	{
+		m_Confirmed = size;
+		m_Link.getOrAdd<LinkStats>()->setMtu( size );
+	}
+}
\ No newline at end of file
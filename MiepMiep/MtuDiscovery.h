@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Packetization layer path mtu discovery (DPLPMTUD, RFC 8899) per link.
+		The link starts at MM_BASE_PLPMTU. Padded probe packets of increasing size are sent and the remote echoes the probe id back.
+		An echoed probe confirms its size, which is published to LinkStats and from then on used to fragment reliable data.
+		A probe that is lost MM_PMTU_MAX_PROBES times in a row, or is rejected by the local stack, marks the size as too big.
+		The next size is chosen by binary search between the confirmed and the failed size.
+		Probes are never resent as data, so losing them does not stall the link.
+	*/
+	class MtuDiscovery: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		MtuDiscovery(Link& link);
+		static EComponentType compType() { return EComponentType::MtuDiscovery; }
+
+		// Called from the SendThread, sends a new probe or resends a timed out one.
+		MM_TS void intervalDispatch( u64 time );
+		// Called from the ReceiveThread for both probes and probe acks.
+		MM_TS void receive( class BinSerializer& bs, const struct PacketInfo& pi );
+
+	private:
+		enum class EProbeKind : byte { Probe, Ack };
+
+		// NOTE: All require the lock.
+		u32  nextProbeSize() const;
+		void sendProbe( u64 time );
+		void onProbeFailed();
+		void setConfirmed( u32 size );
+
+	private:
+		mutex m_Mutex;
+		u32 m_Confirmed;	// Largest size known to reach the remote.
+		u32 m_Failed;		// Smallest size known not to reach the remote, MM_MAX_PLPMTU+1 if none failed.
+		u32 m_ProbeSize;	// Size of the probe in flight, 0 if none.
+		u32 m_ProbeId;
+		u32 m_ProbeCount;	// Number of times the current probe size was sent.
+		u64 m_ProbeSendTS;
+		u64 m_RaiseTS;		// When a completed search looks for a larger mtu again, 0 if not scheduled.
+	};
+}
\ No newline at end of file
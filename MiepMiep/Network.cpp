@@ -4,6 +4,15 @@
 #include "PerThreadDataProvider.h"
 #include "LinkState.h"
 #include "ReliableSend.h"
+#include "UnreliableSend.h"
+#include "ReliableNewSend.h"
+#include "LinkStats.h"
+#include "LinkCompression.h"
+#include "StreamSend.h"
+#include "StreamRecv.h"
+#include "RpcIdTable.h"
+#include "RpcRegistry.h"
+#include "Lz.h"
 #include "JobSystem.h"
 #include "NetworkEvents.h"
 #include "MatchMakerData.h"
@@ -34,11 +43,118 @@ namespace MiepMiep
 		Platform::setLogSettings( logToFile, logToIde );
 	}
 
+	// -------- MessageVariants -------------------------------------------------------------------------------------------
+
+	// The forms in which a message goes to links. Rpc messages carry the rpc name until a link confirmed the rpc id
+	// (see RpcIdTable). Messages are compressed for links that negotiated compression (see LinkCompression).
+	// Each form is built once, on first use for a link that needs it. Only used on the calling thread.
+	class MessageVariants
+	{
+	public:
+		enum { Named = 1, Compressed = 2, Count = 4 };
+
+		MessageVariants( Network& nw, const BinSerializer** bs, u32 numSerializers, const RpcHeader* rpc ):
+			m_Network(nw),
+			m_Rpc(rpc),
+			m_NumSerializers(numSerializers),
+			m_OriginalSize(0)
+		{
+			m_Serializers[0] = bs;
+			m_Serializers[1] = bs;
+			if ( rpc )
+			{
+				// The header is the first serializer.
+				m_NamedSerializers.assign( bs, bs + numSerializers );
+				m_NamedSerializers[0] = &rpc->m_Named;
+				m_Serializers[1] = m_NamedSerializers.data();
+			}
+			for ( u32 i=0; i<2; ++i )
+			{
+				m_State[i] = ENotTried;
+				m_Micros[i] = 0;
+				m_CompressedPtr[i] = &m_Compressed[i];
+			}
+			for ( u32 i=0; i<numSerializers; ++i )
+			{
+				m_OriginalSize += bs[i]->length();
+			}
+		}
+
+		u32 variantFor( Link& link )
+		{
+			u32 variant = (m_Rpc && !link.getOrAdd<RpcIdTable>()->isConfirmed( m_Rpc->m_Id )) ? Named : 0;
+			if ( compressFor( link, variant ) )
+			{
+				variant |= Compressed;
+			}
+			return variant;
+		}
+
+		// Buffered messages go to links that join later, which know no rpc ids and did not negotiate compression yet.
+		u32 bufferVariant() const { return m_Rpc ? Named : 0; }
+
+		const BinSerializer** serializers( u32 variant ) { return (variant & Compressed) ? &m_CompressedPtr[variant & Named] : m_Serializers[variant & Named]; }
+		u32  numSerializers( u32 variant ) const	{ return (variant & Compressed) ? 1 : m_NumSerializers; }
+		byte flags( u32 variant ) const				{ return (variant & Compressed) ? MM_COMPRESSED_BIT : 0; }
+
+		void addStats( Link& link, u32 variant ) const
+		{
+			if ( variant & Compressed )
+			{
+				u32 named = variant & Named;
+				u32 originalSize = m_OriginalSize + (named ? m_Rpc->m_Named.length() - m_Rpc->m_Unnamed.length() : 0);
+				link.getOrAdd<LinkStats>()->addCompressed( originalSize, m_Compressed[named].length(), m_Micros[named] );
+			}
+		}
+
+	private:
+		bool compressFor( Link& link, u32 named )
+		{
+			if ( m_State[named] == ENotWorthIt || !link.getOrAdd<LinkCompression>()->isEnabled() )
+				return false;
+			if ( m_State[named] == ENotTried )
+			{
+				u64 startTime = Util::abs_time_us();
+				bool compressed = PacketHelper::compress( m_Serializers[named], m_NumSerializers, m_Network.compressionDictionary().get(), m_Compressed[named] );
+				m_Micros[named] = (u32)(Util::abs_time_us() - startTime);
+				m_State[named]	= compressed ? ECompressed : ENotWorthIt;
+			}
+			return m_State[named] == ECompressed;
+		}
+
+	private:
+		enum EState { ENotTried, ECompressed, ENotWorthIt };
+
+		Network& m_Network;
+		const RpcHeader* m_Rpc;
+		const BinSerializer** m_Serializers[2]; // Without and with rpc name.
+		vector<const BinSerializer*> m_NamedSerializers;
+		u32 m_NumSerializers;
+		u32 m_OriginalSize;
+		EState m_State[2];
+		u32 m_Micros[2];
+		BinSerializer m_Compressed[2];
+		const BinSerializer* m_CompressedPtr[2];
+	};
+
 	// -------- Network -----------------------------------------------------------------------------------------------------
 
-	Network::Network( bool allowAsyncCallbacks, u32 numWorkerThreads )
+	Network::Network( bool allowAsyncCallbacks, u32 numWorkerThreads ):
+		m_LinkSendRate(0),
+		m_MaxLinkQueueBytes(0),
+		m_MaxLinkQueuePackets(0),
+		m_MaxSessionQueueBytes(0),
+		m_MaxSessionQueuePackets(0),
+		m_CompressionId(0)
 	{
 		if ( numWorkerThreads == 0 ) throw;
+		for ( u32 i=0; i<MM_NUM_CHANNELS; ++i )
+		{
+			m_ChannelPriority[i] = 0;
+			m_ChannelWeight[i] = 1;
+			m_ChannelOrdered[i] = true;
+			m_ChannelFec[i] = (byte)EFecMode::None;
+		}
 		getOrAdd<JobSystem>( 0, numWorkerThreads ); // N worker threads
 		getOrAdd<SendThread>();		 // starts a 'resend' flow and creates jobs per N links whom dispatch their data
 		getOrAdd<SocketSetManager>(); // each N sockets is a new reception thread, default N = 64
@@ -193,14 +309,16 @@ namespace MiepMiep
 	{
 	}
 
-	MM_TS void Network::createRemoteGroup( const string& typeName, u32 netId, const BinSerializer& initData, const IAddress& etp )
+	MM_TS void Network::createRemoteGroup( const string& typeName, u32 netId, const BinSerializer& initData, const ILink& link, byte channel )
 	{
-		void* vgCreatePtr = Platform::getPtrFromName( (string( "deserialize_" ) + typeName).c_str() );
-		if ( vgCreatePtr )
+		RpcFunc vgCreate = RpcRegistry::find( priv_hash_name( typeName.c_str() ) );
+		if ( !vgCreate )
 		{
-			using fptr = void( *)(INetwork&, const IAddress&, const BinSerializer&);
-			((fptr)vgCreatePtr)(*this, etp, initData);
+			LOGW( "Cannot find var group named: %s.", typeName.c_str() );
+			return;
 		}
+		BinSerializer bs( initData );
+		vgCreate( *this, link, bs, channel );
 	}
 
 	MM_TS ESendCallResult Network::sendReliable( byte id, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
@@ -211,49 +329,320 @@ namespace MiepMiep
 	}
 
 	MM_TS ESendCallResult Network::sendReliable( byte id, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
-												 bool buffer, bool relay, bool systemBit, byte channel, IDeliveryTrace* trace )
+												 bool buffer, bool relay, bool systemBit, byte channel, IDeliveryTrace* trace, const RpcHeader* rpc )
 	{
-		vector<sptr<const NormalSendPacket>> packets;
-		if ( !PacketHelper::createNormalPacket( packets, (byte)ReliableSend::compType(), id, bs, numSerializers, channel, relay, systemBit,
-			 MM_MAX_FRAGMENTSIZE /* TODO change for current known max MTU */ ) )
+		MessageVariants variants( *this, bs, numSerializers, rpc );
+
+		// Fragments are sized to the path mtu of each link. Links with the same mtu and message variant share the fragments.
+		map<u64, vector<sptr<const NormalSendPacket>>> fragmentsPerMtu;
+		bool unordered = !isChannelOrdered( channel );
+		u32  linkHdrSize = MM_RELIABLE_LINK_HDR_SIZE + (channelFec( channel ) != EFecMode::None ? MM_FEC_PARITY_OVERHEAD : 0);
+		auto fragmentsFor = [&] ( u32 mtu, u32 variant ) -> const vector<sptr<const NormalSendPacket>>*
+		{
+			u64 key = ((u64)mtu * MessageVariants::Count) + variant;
+			auto fIt = fragmentsPerMtu.find( key );
+			if ( fIt != fragmentsPerMtu.end() )
+			{
+				return &fIt->second;
+			}
+			auto& packets = fragmentsPerMtu[key];
+			const BinSerializer** payload = variants.serializers( variant );
+			u32  numPayload = variants.numSerializers( variant );
+			byte flags = variants.flags( variant );
+			if ( !PacketHelper::createNormalPacket( packets, (byte)ReliableSend::compType(), id, payload, numPayload, channel, relay, systemBit,
+													flags | (unordered ? MM_UNORDERED_BIT : 0), mtu - linkHdrSize ) )
+			{
+				return nullptr;
+			}
+			// An unordered message is only handled once all its fragments are in the receive window, so larger messages go ordered.
+			if ( unordered && packets.size() > MM_RELIABLE_RECV_WINDOW/2 )
+			{
+				packets.clear();
+				if ( !PacketHelper::createNormalPacket( packets, (byte)ReliableSend::compType(), id, payload, numPayload, channel, relay, systemBit, flags,
+														mtu - linkHdrSize ) )
+				{
+					return nullptr;
+				}
+			}
+			return &packets;
+		};
+
+		auto queuedSize = [] ( const vector<sptr<const NormalSendPacket>>& packets )
+		{
+			u64 bytes = 0;
+			for ( auto& p : packets ) bytes += p->m_PayLoad.length();
+			return bytes;
+		};
+
+		Session* ses = const_cast<Session*>( sc<const Session*>(session) );
+		bool somethingWasQueued = false;
+		bool serializationError = false;
+		if ( ses )
+		{
+			// Check the queue limits of all links before queueing, so that the data goes either to all links or to none.
+			bool wouldBlock = false;
+			u64 sessionBytes = 0;
+			u64 sessionPackets = 0;
+			ses->forLink( nullptr, [&] ( Link& link )
+			{
+				auto stats = link.getOrAdd<LinkStats>();
+				sessionBytes   += stats->queuedSendBytes();
+				sessionPackets += stats->queuedSendPackets();
+				if ( &link == exlOrSpecific )
+					return;
+				auto packets = fragmentsFor( stats->mtu(), variants.variantFor( link ) );
+				if ( !packets )
+				{
+					serializationError = true;
+					return;
+				}
+				u64 bytes = queuedSize( *packets );
+				sessionBytes   += bytes;
+				sessionPackets += packets->size();
+				wouldBlock |= exceedsLinkQueueLimits( stats->queuedSendBytes() + bytes, stats->queuedSendPackets() + packets->size() );
+			});
+			if ( serializationError )
+			{
+				return ESendCallResult::SerializationError;
+			}
+			if ( wouldBlock || exceedsSessionQueueLimits( sessionBytes, sessionPackets ) )
+			{
+				ses->forLink( exlOrSpecific, [&] ( Link& link )
+				{
+					link.getOrAdd<LinkStats>()->setSendBlocked();
+				});
+				return ESendCallResult::WouldBlock;
+			}
+
+			// Queue on the send windows of all links at once, so that a window that filled up in the meantime
+			// blocks the whole send instead of losing the message for that link.
+			vector<sptr<Link>> links;
+			vector<u32> linkVariants;
+			vector<sptr<ReliableSend>> sends;
+			vector<ReliableSend::EnqueueTarget> targets;
+			ses->forLink( exlOrSpecific, [&] ( Link& link )
+			{
+				u32  variant = variants.variantFor( link );
+				auto packets = fragmentsFor( link.getOrAdd<LinkStats>()->mtu(), variant );
+				if ( !packets )
+				{
+					serializationError = true;
+					return;
+				}
+				links.emplace_back( link.ptr<Link>() );
+				linkVariants.emplace_back( variant );
+				sends.emplace_back( link.getOrAdd<ReliableSend>( channel ) );
+				targets.push_back( { sends.back().get(), packets } );
+			});
+			if ( serializationError )
+			{
+				return ESendCallResult::SerializationError;
+			}
+			if ( !ReliableSend::enqueueAll( targets, trace ) )
+			{
+				for ( auto& l : links )
+				{
+					l->getOrAdd<LinkStats>()->setSendBlocked();
+				}
+				return ESendCallResult::WouldBlock;
+			}
+			for ( u32 i=0; i<links.size(); ++i )
+			{
+				variants.addStats( *links[i], linkVariants[i] );
+			}
+			somethingWasQueued = !links.empty();
+
+			// Buffered messages are sent to links that join later, of which the path mtu is not known yet.
+			if ( buffer )
+			{
+				auto packets = fragmentsFor( MM_BASE_PLPMTU, variants.bufferVariant() );
+				if ( !packets )
+				{
+					return ESendCallResult::SerializationError;
+				}
+				ses->bufferMsg( *packets, channel );
+			}
+		}
+		else if ( exlOrSpecific )
+		{
+			assert( !buffer ); // Buffer is not valid as the buffered packet is stored at the session which is not available.
+			auto stats = exlOrSpecific->getOrAdd<LinkStats>();
+			u32  variant = variants.variantFor( *exlOrSpecific );
+			auto packets = fragmentsFor( stats->mtu(), variant );
+			if ( !packets )
+			{
+				return ESendCallResult::SerializationError;
+			}
+			if ( exceedsLinkQueueLimits( stats->queuedSendBytes() + queuedSize( *packets ), stats->queuedSendPackets() + packets->size() ) ||
+				 !exlOrSpecific->getOrAdd<ReliableSend>( channel )->enqueue( *packets, trace ) )
+			{
+				stats->setSendBlocked();
+				return ESendCallResult::WouldBlock;
+			}
+			variants.addStats( *exlOrSpecific, variant );
+			somethingWasQueued = true;
+		}
+		if ( serializationError )
 		{
 			return ESendCallResult::SerializationError;
 		}
-		return sendReliable( packets, session, exlOrSpecific, buffer, channel, trace );
+		if ( !somethingWasQueued )
+		{
+			LOG( "Nothing was sent, though a reliable call was made. Either 'session' or 'exlOrSpecific' must NOT be a nullptr." );
+		}
+		return (somethingWasQueued ? ESendCallResult::Fine : ESendCallResult::NotSent );
+	}
+
+	MM_TS ESendCallResult Network::sendUnreliable( byte id, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
+												   bool relay, byte channel )
+	{
+		const BinSerializer* bs2[] = { bs };
+		return sendUnreliable( id, session, sc<Link*>( exlOrSpecific ), bs2, numSerializers, relay, false, channel );
+	}
+
+	MM_TS ESendCallResult Network::sendUnreliable( byte id, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
+												   bool relay, bool systemBit, byte channel, const RpcHeader* rpc )
+	{
+		return sendSinglePacket( (byte)UnreliableSend::compType(), MM_UNRELIABLE_LINK_HDR_SIZE, id, session, exlOrSpecific, bs, numSerializers, relay, systemBit, channel, rpc,
+								 [channel] ( Link& link, const sptr<const NormalSendPacket>& packet )
+		{
+			link.getOrAdd<UnreliableSend>( channel )->enqueue( packet );
+		});
+	}
+
+	MM_TS ESendCallResult Network::sendReliableNewest( byte id, u32 key, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
+													   bool relay, byte channel )
+	{
+		const BinSerializer* bs2[] = { bs };
+		return sendReliableNewest( id, key, session, sc<Link*>( exlOrSpecific ), bs2, numSerializers, relay, false, channel );
 	}
 
-	MM_TS ESendCallResult Network::sendReliable( const vector<sptr<const NormalSendPacket>>& data, const ISession* session, Link* exlOrSpecific,
-												 bool buffer, byte channel, IDeliveryTrace* trace )
+	MM_TS ESendCallResult Network::sendReliableNewest( byte id, u32 key, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
+													   bool relay, bool systemBit, byte channel )
 	{
+		return sendSinglePacket( (byte)ReliableNewSend::compType(), MM_RELIABLE_NEW_LINK_HDR_SIZE, id, session, exlOrSpecific, bs, numSerializers, relay, systemBit, channel, nullptr,
+								 [key, channel] ( Link& link, const sptr<const NormalSendPacket>& packet )
+		{
+			link.getOrAdd<ReliableNewSend>( channel )->enqueue( key, packet );
+		});
+	}
+
+	MM_TS ESendCallResult Network::sendSinglePacket( byte compType, u32 linkHdrSize, byte id, const ISession* session, Link* exlOrSpecific,
+													 const BinSerializer** bs, u32 numSerializers, bool relay, bool systemBit, byte channel, const RpcHeader* rpc,
+													 const function<void (Link&, const sptr<const NormalSendPacket>&)>& enqueue )
+	{
+		// These packets are never fragmented, so the same packet goes to all links that get the same message variant.
+		MessageVariants variants( *this, bs, numSerializers, rpc );
+		sptr<const NormalSendPacket> packets[MessageVariants::Count];
+		ESendCallResult error = ESendCallResult::Fine;
+		u32 variant = 0;
+		auto packetFor = [&] ( Link& link ) -> sptr<const NormalSendPacket>
+		{
+			variant = variants.variantFor( link );
+			auto& packet = packets[variant];
+			if ( !packet )
+			{
+				vector<sptr<const NormalSendPacket>> fragments;
+				if ( !PacketHelper::createNormalPacket( fragments, compType, id, variants.serializers( variant ), variants.numSerializers( variant ),
+														channel, relay, systemBit, variants.flags( variant ), MM_MAX_PLPMTU - linkHdrSize ) )
+				{
+					error = ESendCallResult::SerializationError;
+					return nullptr;
+				}
+				if ( fragments.size() != 1 )
+				{
+					error = ESendCallResult::TooBig;
+					return nullptr;
+				}
+				packet = fragments[0];
+			}
+			if ( packet->m_PayLoad.length() + linkHdrSize > link.getOrAdd<LinkStats>()->mtu() )
+			{
+				error = ESendCallResult::TooBig;
+				return nullptr;
+			}
+			return packet;
+		};
+		auto enqueueOn = [&] ( Link& link )
+		{
+			auto packet = packetFor( link );
+			if ( !packet )
+				return false;
+			variants.addStats( link, variant );
+			enqueue( link, packet );
+			return true;
+		};
+
 		Session* ses = const_cast<Session*>( sc<const Session*>(session) );
 		bool somethingWasQueued = false;
 		if ( ses )
 		{
-			// Make buffering and sending an atomic operation to avoid discrepanties between adding new links and messages
-			// and sending existing messages to new links.
-			if ( buffer )
+			// Either send to all links or to none.
+			ses->forLink( exlOrSpecific, [&] ( Link& link )
 			{
-				ses->bufferMsg( data, channel );
+				packetFor( link );
+			});
+			if ( error != ESendCallResult::Fine )
+			{
+				return error;
 			}
 			ses->forLink( exlOrSpecific, [&] ( Link& link )
 			{
-				link.getOrAdd<ReliableSend>( channel )->enqueue( data, trace );
-				somethingWasQueued = true;
+				somethingWasQueued |= enqueueOn( link );
 			});
 		}
 		else if ( exlOrSpecific )
 		{
-			assert( !buffer ); // Buffer is not valid as the buffered packet is stored at the session which is not available.
-			exlOrSpecific->getOrAdd<ReliableSend>( channel )->enqueue( data, trace );
+			if ( !enqueueOn( *exlOrSpecific ) )
+			{
+				return error;
+			}
 			somethingWasQueued = true;
 		}
 		if ( !somethingWasQueued )
 		{
-			LOG( "Nothing was sent, though a reliable call was made. Either 'session' or 'exlOrSpecific' must NOT be a nullptr." );
+			LOG( "Nothing was sent, though a send was made. Either 'session' or 'exlOrSpecific' must NOT be a nullptr." );
 		}
 		return (somethingWasQueued ? ESendCallResult::Fine : ESendCallResult::NotSent );
 	}
 
+	MM_TS ESendCallResult Network::sendStream( ILink& link, u32 streamId, const StreamReader& reader, byte channel )
+	{
+		if ( channel >= MM_NUM_CHANNELS || !isChannelOrdered( channel ) )
+		{
+			LOGW( "Streams must be sent on an ordered channel, channel %d is not.", (u32)channel );
+			return ESendCallResult::NotSent;
+		}
+		Link& l = sc<Link&>( link );
+		if ( !l.isConnected() )
+		{
+			return ESendCallResult::NotSent;
+		}
+		l.getOrAdd<StreamSend>( channel )->add( streamId, reader );
+		return ESendCallResult::Fine;
+	}
+
+	MM_TS ESendCallResult Network::sendStreamFile( ILink& link, u32 streamId, const std::string& filePath, byte channel )
+	{
+		FILE* f = Platform::fopen( filePath.c_str(), "rb" );
+		if ( !f )
+		{
+			LOGW( "Cannot open %s to stream.", filePath.c_str() );
+			return ESendCallResult::NotSent;
+		}
+		// The file is closed when the stream is done and its reader is released.
+		sptr<FILE> file( f, [] ( FILE* f ) { fclose( f ); } );
+		return sendStream( link, streamId, [file] ( byte* buffer, u32 size )
+		{
+			return (u32)fread( buffer, 1, size, file.get() );
+		}, channel );
+	}
+
+	MM_TS void Network::receiveStreamToFile( ILink& link, u32 streamId, const std::string& filePath )
+	{
+		sc<Link&>( link ).getOrAdd<StreamRecv>()->setFilePath( streamId, filePath );
+	}
+
 	MM_TS void Network::addSessionListener( ISession& session, ISessionListener* listener )
 	{
 		sc<SessionBase&>(session).addListener( listener );
@@ -274,6 +663,105 @@ namespace MiepMiep
 		return m_PacketLossPercentage;
 	}
 
+	MM_TS void Network::setChannelPriority( byte channel, u32 priorityClass, u32 weight )
+	{
+		if ( channel >= MM_NUM_CHANNELS )
+		{
+			LOGW( "Invalid channel %d, must be less than %d.", (u32)channel, MM_NUM_CHANNELS );
+			return;
+		}
+		m_ChannelPriority[channel] = priorityClass;
+		m_ChannelWeight[channel] = Util::max( weight, (u32)1 );
+	}
+
+	MM_TS void Network::setChannelOrdered( byte channel, bool ordered )
+	{
+		if ( channel >= MM_NUM_CHANNELS )
+		{
+			LOGW( "Invalid channel %d, must be less than %d.", (u32)channel, MM_NUM_CHANNELS );
+			return;
+		}
+		m_ChannelOrdered[channel] = ordered;
+	}
+
+	MM_TS void Network::setChannelFec( byte channel, EFecMode mode )
+	{
+		if ( channel >= MM_NUM_CHANNELS )
+		{
+			LOGW( "Invalid channel %d, must be less than %d.", (u32)channel, MM_NUM_CHANNELS );
+			return;
+		}
+		m_ChannelFec[channel] = (byte)mode;
+	}
+
+	MM_TS void Network::setLinkSendRate( u32 bytesPerSecond )
+	{
+		m_LinkSendRate = bytesPerSecond;
+	}
+
+	MM_TS void Network::setSendQueueLimits( u32 maxLinkBytes, u32 maxLinkPackets, u32 maxSessionBytes, u32 maxSessionPackets )
+	{
+		m_MaxLinkQueueBytes = maxLinkBytes;
+		m_MaxLinkQueuePackets = maxLinkPackets;
+		m_MaxSessionQueueBytes = maxSessionBytes;
+		m_MaxSessionQueuePackets = maxSessionPackets;
+	}
+
+	MM_TS bool Network::exceedsLinkQueueLimits( u64 bytes, u64 packets ) const
+	{
+		return (m_MaxLinkQueueBytes != 0 && bytes > m_MaxLinkQueueBytes) ||
+			   (m_MaxLinkQueuePackets != 0 && packets > m_MaxLinkQueuePackets);
+	}
+
+	MM_TS bool Network::exceedsSessionQueueLimits( u64 bytes, u64 packets ) const
+	{
+		return (m_MaxSessionQueueBytes != 0 && bytes > m_MaxSessionQueueBytes) ||
+			   (m_MaxSessionQueuePackets != 0 && packets > m_MaxSessionQueuePackets);
+	}
+
+	MM_TS bool Network::isLinkQueueDrained( u64 bytes, u64 packets ) const
+	{
+		// Drained at half the link limits, so that a sender does not flip between blocked and unblocked on every ack.
+		// Without link limits, the session limits decide if there are any, otherwise the link was blocked by a full send window and is drained when empty.
+		u32 maxBytes   = m_MaxLinkQueueBytes;
+		u32 maxPackets = m_MaxLinkQueuePackets;
+		if ( maxBytes == 0 && maxPackets == 0 )
+		{
+			return hasSessionQueueLimits() || packets == 0;
+		}
+		return (maxBytes == 0 || bytes <= maxBytes/2) && (maxPackets == 0 || packets <= maxPackets/2);
+	}
+
+	MM_TS bool Network::isSessionQueueDrained( u64 bytes, u64 packets ) const
+	{
+		u32 maxBytes   = m_MaxSessionQueueBytes;
+		u32 maxPackets = m_MaxSessionQueuePackets;
+		return (maxBytes == 0 || bytes <= maxBytes/2) && (maxPackets == 0 || packets <= maxPackets/2);
+	}
+
+	MM_TS bool Network::hasSessionQueueLimits() const
+	{
+		return m_MaxSessionQueueBytes != 0 || m_MaxSessionQueuePackets != 0;
+	}
+
+	MM_TS void Network::setCompression( bool enable, const byte* dictionary, u32 size )
+	{
+		sptr<const LzDictionary> dict;
+		if ( enable && dictionary && size != 0 )
+		{
+			dict = make_shared<LzDictionary>( dictionary, size );
+		}
+		scoped_lock lk( m_CompressionMutex );
+		m_CompressionDictionary = dict;
+		m_CompressionId = !enable ? 0 : dict ? Util::max( dict->m_Id, (u32)MM_COMPRESSION_NO_DICT_ID+1 ) : MM_COMPRESSION_NO_DICT_ID;
+	}
+
+	MM_TS sptr<const LzDictionary> Network::compressionDictionary() const
+	{
+		scoped_lock lk( m_CompressionMutex );
+		return m_CompressionDictionary;
+	}
+
     MM_TS u32 Network::nextSessionId()
     {
         return m_NextSessionId++;
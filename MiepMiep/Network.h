@@ -15,6 +15,8 @@ namespace MiepMiep
 	class  ISocket;
 	struct SocketAddrPair;
 	class  MasterSessionList;
+	struct LzDictionary;
+	struct RpcHeader;
 
 	enum class ENetworkError
 	{
@@ -57,20 +59,50 @@ namespace MiepMiep
 
 		MM_TS void createGroupInternal( const Session& session, const string& typeName, const BinSerializer& initData, byte channel, IDeliveryTrace* trace );
 		MM_TS void destroyGroup( u32 groupId ) override;
-		MM_TS void createRemoteGroup( const string& typeName, u32 netId, const BinSerializer& initData, const IAddress& etp );
+		MM_TS void createRemoteGroup( const string& typeName, u32 netId, const BinSerializer& initData, const ILink& link, byte channel );
 
 		MM_TS ESendCallResult sendReliable(byte id, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
 										   bool buffer, bool relay, byte channel, IDeliveryTrace* trace) override;
+		// With 'rpc', the first serializer must be its unnamed header.
 		MM_TS ESendCallResult sendReliable(byte id, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
-										   bool buffer, bool relay, bool systemBit,  byte channel, IDeliveryTrace* trace);
-		MM_TS ESendCallResult sendReliable(const vector<sptr<const struct NormalSendPacket>>&, const ISession* session, Link* exlOrSpecific,
-										   bool buffer, byte channel, IDeliveryTrace* trace);
+										   bool buffer, bool relay, bool systemBit,  byte channel, IDeliveryTrace* trace, const RpcHeader* rpc=nullptr);
+		MM_TS ESendCallResult sendUnreliable(byte id, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
+											 bool relay, byte channel) override;
+		MM_TS ESendCallResult sendUnreliable(byte id, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
+											 bool relay, bool systemBit, byte channel, const RpcHeader* rpc=nullptr);
+		MM_TS ESendCallResult sendReliableNewest(byte id, u32 key, const ISession* session, ILink* exlOrSpecific, const BinSerializer* bs, u32 numSerializers,
+												 bool relay, byte channel) override;
+		MM_TS ESendCallResult sendReliableNewest(byte id, u32 key, const ISession* session, Link* exlOrSpecific, const BinSerializer** bs, u32 numSerializers,
+												 bool relay, bool systemBit, byte channel);
+		MM_TS ESendCallResult sendStream(ILink& link, u32 streamId, const StreamReader& reader, byte channel) override;
+		MM_TS ESendCallResult sendStreamFile(ILink& link, u32 streamId, const std::string& filePath, byte channel) override;
+		MM_TS void receiveStreamToFile(ILink& link, u32 streamId, const std::string& filePath) override;
 
 		MM_TS void addSessionListener( ISession& session, ISessionListener* listener ) override;
 		MM_TS void removeSessionListener( ISession& session, const ISessionListener* listener ) override;
 
 		MM_TS void simulatePacketLoss( u32 percentage ) override;
 		MM_TS u32  packetLossPercentage() const;
+
+		MM_TS void setChannelPriority( byte channel, u32 priorityClass, u32 weight ) override;
+		MM_TS void setChannelOrdered( byte channel, bool ordered ) override;
+		MM_TS void setChannelFec( byte channel, EFecMode mode ) override;
+		MM_TS void setLinkSendRate( u32 bytesPerSecond ) override;
+		MM_TS u32  channelPriority( byte channel ) const	{ return m_ChannelPriority[channel]; }
+		MM_TS u32  channelWeight( byte channel ) const		{ return m_ChannelWeight[channel]; }
+		MM_TS bool isChannelOrdered( byte channel ) const	{ return m_ChannelOrdered[channel]; }
+		MM_TS EFecMode channelFec( byte channel ) const		{ return (EFecMode)m_ChannelFec[channel].load(); }
+		MM_TS u32  linkSendRate() const						{ return m_LinkSendRate; }
+
+		MM_TS void setSendQueueLimits( u32 maxLinkBytes, u32 maxLinkPackets, u32 maxSessionBytes, u32 maxSessionPackets ) override;
+		MM_TS void setCompression( bool enable, const byte* dictionary, u32 size ) override;
+		MM_TS u32  compressionId() const					{ return m_CompressionId; } // 0 if disabled
+		MM_TS sptr<const LzDictionary> compressionDictionary() const;
+		MM_TS bool exceedsLinkQueueLimits( u64 bytes, u64 packets ) const;
+		MM_TS bool exceedsSessionQueueLimits( u64 bytes, u64 packets ) const;
+		MM_TS bool isLinkQueueDrained( u64 bytes, u64 packets ) const;
+		MM_TS bool isSessionQueueDrained( u64 bytes, u64 packets ) const;
+		MM_TS bool hasSessionQueueLimits() const;
         MM_TS u32  nextSessionId();
 
 
@@ -91,13 +123,31 @@ namespace MiepMiep
 
 		// Send rpc with system bit (true or false). Other than that, exactly same as Inetwork.callRpc
 		template <typename T, typename ...Args> 
-		MM_TS ESendCallResult callRpc2( Args... args, const Session* session, ILink* exclOrSpecific=nullptr, 
+		MM_TS ESendCallResult callRpc2( const Args&... args, const Session* session, ILink* exclOrSpecific=nullptr, 
 										bool localCall=false, bool buffer=false, bool relay=false, bool systemBit=true, 
 										byte channel=0, IDeliveryTrace* trace=nullptr );
 
+	private:
+		// Sends a message that must fit in a single packet on every link, such as unreliable and reliable newest messages.
+		MM_TS ESendCallResult sendSinglePacket( byte compType, u32 linkHdrSize, byte id, const ISession* session, Link* exlOrSpecific,
+												const BinSerializer** bs, u32 numSerializers, bool relay, bool systemBit, byte channel, const RpcHeader* rpc,
+												const function<void (Link&, const sptr<const NormalSendPacket>&)>& enqueue );
+
 	private:
 		atomic_uint m_PacketLossPercentage;
+		atomic_uint m_ChannelPriority[MM_NUM_CHANNELS];
+		atomic_uint m_ChannelWeight[MM_NUM_CHANNELS];
+		atomic_bool m_ChannelOrdered[MM_NUM_CHANNELS];
+		atomic<byte> m_ChannelFec[MM_NUM_CHANNELS];
+		atomic_uint m_LinkSendRate;
+		atomic_uint m_MaxLinkQueueBytes;
+		atomic_uint m_MaxLinkQueuePackets;
+		atomic_uint m_MaxSessionQueueBytes;
+		atomic_uint m_MaxSessionQueuePackets;
         atomic_uint m_NextSessionId;
+		atomic_uint m_CompressionId;
+		mutable mutex m_CompressionMutex;
+		sptr<const LzDictionary> m_CompressionDictionary;
 	};
 
 
@@ -132,13 +182,13 @@ namespace MiepMiep
 	}
 
 	template <typename T, typename ...Args>
-	MM_TS ESendCallResult MiepMiep::Network::callRpc2(Args... args, const Session* session, ILink* exclOrSpecific,
+	MM_TS ESendCallResult MiepMiep::Network::callRpc2(const Args&... args, const Session* session, ILink* exclOrSpecific,
 													  bool localCall, bool buffer, bool relay, bool systemBit,
 													  byte channel, IDeliveryTrace* trace)
 	{
 		auto& bs = priv_get_thread_serializer();
 		T::rpc<Args...>(args..., *this, bs, localCall, channel);
-		return priv_send_rpc( *this, T::rpcName(), bs, session, exclOrSpecific, buffer, relay, systemBit, channel, trace );
+		return priv_send_rpc( *this, T::rpcHeader(), bs, session, exclOrSpecific, buffer, relay, systemBit, channel, trace );
 	}
 
 
@@ -10,6 +10,7 @@
 #include "LinkManager.h"
 #include "Link.h"
 #include "Session.h"
+#include "Lz.h"
 #include <iostream>
 
 
@@ -17,72 +18,73 @@ namespace MiepMiep
 {
 	// --- Packet ------------------------------------------------------------------------------------------
 
+	static sptr<byte> allocShared( u32 len )
+	{
+		return sptr<byte>( reserveN<byte>(MM_FL, len), [] ( byte* p ) { releaseN( p ); } );
+	}
+
 	RecvPacket::RecvPacket(byte id, u32 len, byte flags):
 		m_Id(id),
-		m_Data(reserveN<byte>(MM_FL, len)),
 		m_Length(len),
-		m_Flags(flags)
+		m_Flags(flags),
+		m_Buffer(allocShared(len))
 	{
-		// Remainder is zeroed by 'calloc'.
-	//	cout << "Pack constructor." << endl;
+		m_Data = m_Buffer.get();
 	}
 
 	RecvPacket::RecvPacket(byte id, class BinSerializer& bs):
 		RecvPacket(id, bs.data(), bs.length(), 0, true)
 	{
-	//	cout << "Pack constructor." << endl;
 	}
 
 	RecvPacket::RecvPacket(byte id, const byte* data, u32 len, byte flags, bool copy):
 		m_Id(id),
-		m_Data(copy ? reserveN<byte>(MM_FL, len) : const_cast<byte*>(data)),
+		m_Data(const_cast<byte*>(data)),
 		m_Length(len),
 		m_Flags(flags)
 	{
-		if ( copy ) Platform::memCpy(m_Data, len, data, len);
-	//	cout << "Pack constructor." << endl;
+		if ( copy )
+		{
+			m_Buffer = allocShared(len);
+			m_Data = m_Buffer.get();
+			Platform::memCpy(m_Data, len, data, len);
+		}
 	}
 
 	RecvPacket::RecvPacket(const RecvPacket& p):
-		RecvPacket(p.m_Id, p.m_Data, p.m_Length, p.m_Flags, true)
-	{
-	//	cout << "Pack const copy constructor." << endl;
-	}
-
-	RecvPacket::RecvPacket(RecvPacket&& p) noexcept:
 		m_Id(p.m_Id),
 		m_Data(p.m_Data),
 		m_Length(p.m_Length),
-		m_Flags(p.m_Flags)
+		m_Flags(p.m_Flags),
+		m_Buffer(p.m_Buffer)
 	{
-		p.m_Data = nullptr;
-	//	cout << "Pack non-const move constructor." << endl;
+		if ( !m_Buffer && m_Data )
+		{
+			*this = RecvPacket(p.m_Id, p.m_Data, p.m_Length, p.m_Flags, true);
+		}
 	}
 
 	RecvPacket& RecvPacket::operator=(const RecvPacket& p)
 	{
-		m_Id = p.m_Id;
-		m_Length = p.m_Length;
-		m_Flags  = p.m_Flags;
-		releaseN(m_Data);
-		m_Data = reserveN<byte>(MM_FL, m_Length);
-		Platform::memCpy(m_Data, m_Length, p.m_Data, m_Length);
-	//	cout << "Pack asignment." << endl;
+		if ( this != &p )
+		{
+			*this = RecvPacket(p);
+		}
 		return *this;
 	}
 
-	RecvPacket& RecvPacket::operator=(RecvPacket&& p) noexcept
+	RecvPacket RecvPacket::slice(u32 offset) const
 	{
-		Platform::copy<RecvPacket>(this, &p, 1);
-		p.m_Data = nullptr;
-	//	cout << "Pack non-const move asignment." << endl;
-		return *this;
+		assert( offset <= m_Length );
+		return slice( offset, m_Length - offset );
 	}
 
-	RecvPacket::~RecvPacket()
+	RecvPacket RecvPacket::slice(u32 offset, u32 len) const
 	{
-		releaseN(m_Data);
-	//	cout << "Pack destructor." << endl;
+		assert( offset + len <= m_Length );
+		RecvPacket p(m_Id, m_Data + offset, len, m_Flags, !m_Buffer);
+		if ( m_Buffer ) p.m_Buffer = m_Buffer;
+		return p;
 	}
 
 
@@ -128,10 +130,13 @@ namespace MiepMiep
 	bool PacketHelper::createNormalPacket(vector<sptr<const NormalSendPacket>>& framgentsOut,  
 										  byte compType, byte dataId,
 										  const BinSerializer** serializers, u32 numSerializers,
-										  byte channel, bool relay, bool sysBit, i32 maxFragmentSize)
+										  byte channel, bool relay, bool sysBit, byte extraFlags, i32 maxFragmentSize)
 	{
-		// actual fragmentSize is somewhat lower due to fragment hdr overhead, subtract this, so that fragmentSize is never exceeded
-		maxFragmentSize -= MM_MIN_HDR_SIZE;
+		// 'maxFragmentSize' is the payload size excluding the link specific hdr (seq etc.), which is written on send.
+		// Each fragment starts with compType(1) + channelAndFlags(1) and the first also holds the dataId(1), so fill
+		// every fragment up to exactly 'maxFragmentSize'.
+		// If the message needs more than one fragment, the first also holds totalLength(4) + numFragments(4), so that the
+		// receiver allocates the message once and copies each fragment to its offset as it arrives.
 		// ensure we have at least space to store data
 		if ( maxFragmentSize <= MM_MIN_HDR_SIZE*2 )
 		{
@@ -140,12 +145,23 @@ namespace MiepMiep
 			return false;
 		}
 		byte channelAndFlags = makeChannelAndFlags(channel, relay, sysBit, true, false );
+		channelAndFlags |= extraFlags;
 		// --
 		u32 totalLength = 0;
 		for ( u32 i=0; i< numSerializers; ++i )
 		{
 			totalLength += serializers[i]->length();
 		}
+		u32 messageLength  = totalLength;
+		u32 firstHdrSize   = 3;
+		u32 numFragments   = 1;
+		if ( totalLength > (u32)maxFragmentSize - firstHdrSize )
+		{
+			firstHdrSize += MM_FRAGMENT_INFO_SIZE;
+			u32 firstLength = maxFragmentSize - firstHdrSize;
+			u32 fragmentLength = maxFragmentSize - 2;
+			numFragments += (totalLength - firstLength + fragmentLength - 1) / fragmentLength;
+		}
 		u32 offset = 0;
 		bool quit  = false;
 		bool isFirstFragment = true;
@@ -154,7 +170,8 @@ namespace MiepMiep
 		{
 			auto sp = make_shared<NormalSendPacket>();
 			BinSerializer& fragment = sp->m_PayLoad;
-			u32 writeLen = Util::min(totalLength, (u32)maxFragmentSize);
+			u32 fragmentHdrSize = isFirstFragment ? firstHdrSize : 2;
+			u32 writeLen = Util::min(totalLength, (u32)maxFragmentSize - fragmentHdrSize);
 			totalLength -= writeLen;
 			if ( 0 == totalLength )
 			{
@@ -166,6 +183,11 @@ namespace MiepMiep
 			if ( isFirstFragment )
 			{
 				__CHECKEDB( fragment.write( dataId ) );
+				if ( numFragments > 1 )
+				{
+					__CHECKEDB( fragment.write( messageLength ) );
+					__CHECKEDB( fragment.write( numFragments ) );
+				}
 				channelAndFlags &= ~(MM_FRAGMENT_FIRST_BIT);
 				isFirstFragment  = false;
 			}
@@ -188,69 +210,61 @@ namespace MiepMiep
 			}
 			framgentsOut.emplace_back( sp );
 		} while (!quit);
+		assert( framgentsOut.size() >= numFragments );
 		return true; // jeej
 	}
 
-	bool PacketHelper::tryReassembleBigPacket(sptr<const RecvPacket>& finalPack, std::map<u32, sptr<const RecvPacket>>& fragments, u32 seq, u32& seqBegin, u32& seqEnd)
+	bool PacketHelper::compress( const BinSerializer** serializers, u32 numSerializers, const LzDictionary* dict, BinSerializer& out )
 	{
-		// try find begin
-		seqBegin = seq;
-		auto itBegin = fragments.find( seqBegin );
-		while ( itBegin != fragments.end() )
+		u32 totalLen = 0;
+		for ( u32 i=0; i<numSerializers; ++i )
+		{
+			totalLen += serializers[i]->length();
+		}
+		if ( totalLen < MM_COMPRESSION_MIN_SIZE )
 		{
-			const sptr<const RecvPacket>& pack = itBegin->second;
-			if ( (pack->m_Flags & MM_FRAGMENT_FIRST_BIT) != 0 )
+			return false;
+		}
+
+		// The codec needs a contiguous input.
+		const byte* src = serializers[0]->data();
+		vector<byte> joined;
+		if ( numSerializers > 1 )
+		{
+			joined.reserve( totalLen );
+			for ( u32 i=0; i<numSerializers; ++i )
 			{
-				// found begin, try find end now..
-				seqEnd = seq;
-				auto itEnd = fragments.find( seqEnd );
-				while ( itEnd != fragments.end() )
-				{
-					const sptr<const RecvPacket>& pack = itEnd->second;
-					if ( (pack->m_Flags & MM_FRAGMENT_LAST_BIT) != 0 )
-					{
-						// all fragments available, re-assemble framgents to one pack
-						finalPack = reAssembleBigPacket(fragments, seqBegin, seqEnd);
-						return true;
-					}
-					itEnd = fragments.find( ++seqEnd );
-				}
-				return false;
+				joined.insert( joined.end(), serializers[i]->data(), serializers[i]->data() + serializers[i]->length() );
 			}
-			itBegin = fragments.find( --seqBegin );
+			src = joined.data();
 		}
-		return false;
+
+		// The codec bails out as soon as the output exceeds the capacity, so a message that does not shrink costs little.
+		vector<byte> compressed( totalLen );
+		u32 size = Lz::compress( src, totalLen, dict, compressed.data(), totalLen - MM_COMPRESSION_MIN_GAIN );
+		if ( size == 0 )
+		{
+			return false;
+		}
+		out.reset();
+		__CHECKEDB( out.write( compressed.data(), size ) );
+		return true;
 	}
 
-	sptr<const RecvPacket> PacketHelper::reAssembleBigPacket(std::map<u32, sptr<const RecvPacket>>& fragments, u32 seqBegin, u32 seqEnd)
+	sptr<const RecvPacket> PacketHelper::decompress( const RecvPacket& pack, const LzDictionary* dict )
 	{
-		// Count total length.
-		u32 totalLen = 0;
-		u32 curSeq = seqBegin;
-		while (curSeq != seqEnd+1) // take into account that seq wraps
+		// Bound the size to not allocate whatever a corrupt or malicious header claims.
+		u32 len = Lz::originalSize( pack.m_Data, pack.m_Length );
+		if ( len == 0 || len > MM_MAX_DECOMPRESSED_SIZE )
 		{
-			totalLen += fragments[curSeq]->m_Length;
-			curSeq++;
+			return nullptr;
 		}
-
-		// Allocate data for packet (copy id and flags from first fragment)
-		auto& firstFrag = fragments[seqBegin];
-		auto finalPack  = make_shared<RecvPacket>( firstFrag->m_Id, totalLen, firstFrag->m_Flags );
-
-		// Copy each fragment
-		curSeq = seqBegin;
-		u32 curLen = 0;
-		while (curSeq != seqEnd+1) // take into count that seq wraps
+		auto original = make_shared<RecvPacket>( pack.m_Id, len, (byte)(pack.m_Flags & ~MM_COMPRESSED_BIT) );
+		if ( !Lz::decompress( pack.m_Data, pack.m_Length, dict, original->m_Data, len ) )
 		{
-			auto fragIt = fragments.find(curSeq);
-			const sptr<const RecvPacket>& frag = fragIt->second;
-			Platform::memCpy( finalPack->m_Data + curLen, (totalLen-curLen), frag->m_Data, frag->m_Length );
-			curLen += frag->m_Length;
-			fragments.erase( fragIt );
-			curSeq++;
+			return nullptr;
 		}
-
-		return finalPack;
+		return original;
 	}
 
 	bool PacketHelper::isSeqNewer(u32 incoming, u32 having)
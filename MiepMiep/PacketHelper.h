@@ -18,23 +18,30 @@ namespace MiepMiep
 	struct SocketAddrPair;
 
 
+	/*	Copies and slices share the same refcounted bytes, so a payload is copied once when it is received and then
+		flows to the events without further copies. The bytes must not be changed once shared.
+		A packet constructed without 'copy' views memory that it does not own, copying it owns its bytes. */
 	struct RecvPacket
 	{
 	public:
-		RecvPacket() = default; // Auto zeroed, due to 'calloc'.
+		RecvPacket() = default;
 		RecvPacket(byte id, class BinSerializer& bs);
 		RecvPacket(byte id, u32 len, byte flags);
 		RecvPacket(byte id, const byte* data, u32 len, byte flags, bool copy);
 		RecvPacket(const RecvPacket& p);
-		RecvPacket(RecvPacket&& p) noexcept;
+		RecvPacket(RecvPacket&& p) noexcept = default;
 		RecvPacket& operator=(const RecvPacket& p);
-		RecvPacket& operator=(RecvPacket&& p) noexcept;
-		~RecvPacket();
-	
-		byte  m_Id;
-		byte* m_Data;
-		u32   m_Length;
-		byte  m_Flags;
+		RecvPacket& operator=(RecvPacket&& p) noexcept = default;
+
+		// The bytes from 'offset' to the end.
+		RecvPacket slice(u32 offset) const;
+		RecvPacket slice(u32 offset, u32 len) const;
+
+		byte  m_Id = 0;
+		byte* m_Data = nullptr;
+		u32   m_Length = 0;
+		byte  m_Flags = 0;
+		sptr<byte> m_Buffer; // Null if the bytes are not owned.
 	};
 
 	struct PacketInfo
@@ -55,9 +62,13 @@ namespace MiepMiep
 		static bool beginUnfragmented( BinSerializer& b, u32 seq, byte compType, byte dataId, byte channel, bool relay, bool sysBit );
 		static bool beginUnfragmented( BinSerializer& bs, byte compType, byte dataId, byte channel, bool relay, bool sysBit );
 		static bool createNormalPacket( vector<sptr<const struct NormalSendPacket>>& framgentsOut, byte compType, byte dataId, 
-										const BinSerializer** serializers, u32 numSerializers, byte channel, bool relay, bool sysBit, i32 fragmentSize );
-		static bool tryReassembleBigPacket(sptr<const RecvPacket>& finalPack, std::map<u32, sptr<const RecvPacket>>& fragments, u32 seq, u32& seqBegin, u32& seqEnd);
-		static sptr<const RecvPacket> reAssembleBigPacket(std::map<u32, sptr<const RecvPacket>>& fragments, u32 seqBegin, u32 seqEnd);
+										const BinSerializer** serializers, u32 numSerializers, byte channel, bool relay, bool sysBit, byte extraFlags,
+										i32 maxFragmentSize );
+		// Compresses the concatenated serializers into 'out', which is then sent with MM_COMPRESSED_BIT set.
+		// Returns false if the message is too small or does not shrink enough to be worth it.
+		static bool compress( const BinSerializer** serializers, u32 numSerializers, const struct LzDictionary* dict, BinSerializer& out );
+		// Returns nullptr if the data is corrupt.
+		static sptr<const RecvPacket> decompress( const RecvPacket& pack, const struct LzDictionary* dict );
 		static bool isSeqNewer( u32 incoming, u32 having );
 	};
 }
@@ -83,41 +83,6 @@ namespace MiepMiep
 		return true;
 	}
 
-	void* Platform::getPtrFromName(const char* name)
-	{
-		scoped_lock lk(m_Name2FuncMutex);
-
-		auto it = m_Name2Func.find( name );
-		if ( it == m_Name2Func.end() )
-		{
-			// ptr to function
-			void* pf = nullptr;
-
-		#if MM_SDLCORE
-			pf = SDL_LoadFunction(nullptr, name);
-		#else
-			#if MM_PLATFORM_WINDOWS
-				HMODULE hModule = ::GetModuleHandle(nullptr);
-				pf = ::GetProcAddress( hModule, name );
-			#endif
-		#endif
-
-			if ( pf )
-			{
-				m_Name2Func.insert( std::make_pair( name, pf ) );
-			}
-
-			return pf;
-		}
-		return it->second;
-	}
-
-	// To get from user code to find func -->
-	MM_TS void* priv_get_rpc_func(const std::string& name)
-	{
-		return Platform::getPtrFromName( (std::string("rpc_dsr_") + name).c_str() );
-	}
-
 	void Platform::log(ELogType ltype, const char* fname, u64 line, const char* msg, ...)
 	{
 		rscoped_lock lk(m_LogMutex);
@@ -175,13 +140,7 @@ namespace MiepMiep
 		isFirstOpen = false;
 
 		// (Re)open file
-		FILE* f;
-	#if MM_SECURE_CRT
-		fopen_s(&f, fileName, "a");
-	#else
-		f = fopen(fileName, "a");
-	#endif
-
+		FILE* f = fopen(fileName, "a");
 		if (!f) return;
 
 		fprintf(f, msg);
@@ -227,6 +186,17 @@ namespace MiepMiep
 	#endif
 	}
 
+	FILE* Platform::fopen(const char* name, const char* mode)
+	{
+		FILE* f;
+	#if MM_SECURE_CRT
+		if ( 0 != fopen_s(&f, name, mode) ) f = nullptr;
+	#else
+		f = ::fopen(name, mode);
+	#endif
+		return f;
+	}
+
 	void Platform::fprintf(FILE* f, const char* msg)
 	{
 		assert(f && msg);
@@ -269,8 +239,6 @@ namespace MiepMiep
 	bool Platform::m_LogToFile = true;
 	bool Platform::m_LogToIde  = true;
 	mutex Platform::m_InitMutex;
-	mutex Platform::m_Name2FuncMutex;
 	mutex Platform::m_LocalTimeMutex;
 	recursive_mutex Platform::m_LogMutex;
-	map<string, void*> Platform::m_Name2Func;
 }
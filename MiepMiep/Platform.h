@@ -44,8 +44,6 @@ namespace MiepMiep
 			Only when refcount becomes zero, it actually shuts down. */
 		MM_TS static bool shutdown();
 
-		// Obtain ptr to address in executing img, given that the function was exported.
-		MM_TS static void* getPtrFromName(const char* name);
 
 		// Log
 		MM_TS static void log( ELogType ltype, const char* fname, u64 line, const char* msg, ... );
@@ -61,6 +59,7 @@ namespace MiepMiep
 		static void sleep( u32 milliSeconds );
 		static void memCpy(void* dst, u64 size, const void* src, u64 srcSize);
 		static void fprintf(FILE* f, const char* msg);
+		static FILE* fopen(const char* name, const char* mode);
 		template<typename T> static void copy(T* dst, const T* src, u64 cnt);
 
 	private:
@@ -72,9 +71,7 @@ namespace MiepMiep
 		static bool  m_LogToIde;
 		static mutex m_InitMutex;
 		static mutex m_LocalTimeMutex;
-		static mutex m_Name2FuncMutex;
 		static recursive_mutex m_LogMutex;
-		static map<string, void*> m_Name2Func;
 	};
 
 
@@ -1,7 +1,9 @@
 #include "ReliableAckRecv.h"
 #include "ReliableSend.h"
 #include "Link.h"
+#include "LinkStats.h"
 #include "Platform.h"
+#include "Util.h"
 
 
 namespace MiepMiep
@@ -16,6 +18,21 @@ namespace MiepMiep
 	{
 		static thread_local vector<u32> receivedSequences;
 		receivedSequences.clear();
+
+		// Echoed timestamp of our most recent packet and the time the remote held the ack, see ReliableAckSend.
+		u32 echoTimestamp;
+		u16 ackDelay;
+		__CHECKED( bs.read( echoTimestamp ) );
+		__CHECKED( bs.read( ackDelay ) );
+		if ( ackDelay != MM_INVALID_ACK_DELAY )
+		{
+			u32 elapsed = (u32)Util::abs_time() - echoTimestamp; // wraps correctly
+			if ( elapsed >= ackDelay )
+			{
+				m_Link.getOrAdd<LinkStats>()->addRttSample( elapsed - ackDelay );
+			}
+		}
+
 		while ( bs.getRead() != bs.getWrite() )
 		{
 			u32 seq;
@@ -3,29 +3,59 @@
 #include "LinkStats.h"
 #include "PerThreadDataProvider.h"
 #include "PacketHelper.h"
+#include "Util.h"
 
 
 namespace MiepMiep
 {
 	ReliableAckSend::ReliableAckSend(Link& link):
 		ParentLink(link),
-		m_LastResendTS(0)
+		m_LastResendTS(0),
+		m_HasEcho(false),
+		m_EchoTimestamp(0),
+		m_EchoReceivedTS(0)
 	{
 	}
 
+	MM_TS void ReliableAckSend::addAck( u32 ack, u32 timestamp )
+	{
+		scoped_lock lk(m_PacketsMutex);
+		m_ReceivedPackets.emplace_back( ack );
+		m_HasEcho = true;
+		m_EchoTimestamp  = timestamp;
+		m_EchoReceivedTS = Util::abs_time();
+	}
+
 	MM_TS void ReliableAckSend::addAck( u32 ack )
 	{
 		scoped_lock lk(m_PacketsMutex);
 		m_ReceivedPackets.emplace_back( ack );
 	}
 
+	// NOTE: Requires packets lock.
+	bool ReliableAckSend::beginAckPacket( BinSerializer& bs, u64 time )
+	{
+		__CHECKEDB( PacketHelper::beginUnfragmented( bs, 0, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
+		// [ echoTimestamp(4) | ackDelay(2) ] Only the first ack packet of a dispatch carries a valid echo.
+		u16 ackDelay = MM_INVALID_ACK_DELAY;
+		if ( m_HasEcho )
+		{
+			ackDelay  = (u16)Util::min( time - m_EchoReceivedTS, (u64)MM_MAX_ACK_DELAY );
+			m_HasEcho = false;
+		}
+		__CHECKEDB( bs.write( m_EchoTimestamp ) );
+		__CHECKEDB( bs.write( ackDelay ) );
+		return true;
+	}
+
 	MM_TS void ReliableAckSend::resend()
 	{
 		auto& bs = PerThreadDataProvider::getSerializer(true);
-		__CHECKED( PacketHelper::beginUnfragmented( bs, 0, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
 		bool hasPendingWrites = false;
 		u32 mtu = m_Link.getOrAdd<LinkStats>()->mtuAdjusted();
+		u64 time = Util::abs_time();
 		scoped_lock lk( m_PacketsMutex );
+		__CHECKED( beginAckPacket( bs, time ) );
 		for ( u32 ack : m_ReceivedPackets )
 		{
 			__CHECKED( bs.write( ack ) );
@@ -33,7 +63,7 @@ namespace MiepMiep
 			if ( bs.length() >= mtu )
 			{
 				m_Link.send( bs.data(), bs.length() );
-				__CHECKED( PacketHelper::beginUnfragmented( bs, 0, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
+				__CHECKED( beginAckPacket( bs, time ) );
 				hasPendingWrites = false;
 			//	this_thread::sleep_for( chrono::milliseconds( 2 ) ); // TODO remove
 			}
@@ -14,6 +14,8 @@ namespace MiepMiep
 		Each interval dispatch, this list of acks is transmitted and the list is cleared.
 		The idea is to aggregate small amount of ack packets in a single bigger packet.
 		Replying each reliable packet with a single ack packet would result in many very small packets.
+		The timestamp of the most recently received packet is echoed back together with the time the ack was held,
+		so that the sender can measure the round trip time without the aggregation delay.
 	*/
 	class ReliableAckSend: public ParentLink, public IComponent, public ITraceable
 	{
@@ -22,15 +24,22 @@ namespace MiepMiep
 		static EComponentType compType() { return EComponentType::ReliableAckSend; }
 
 		// Note: These functions must be thread safe as the ReceiveThread adds acks while the SendThread resends the ack list.
-		MM_TS void addAck( u32 ack );
+		MM_TS void addAck( u32 ack, u32 timestamp );
+		MM_TS void addAck( u32 ack ); // Without timestamp echo.
 		MM_TS void resend();
 
 		// Resend only if 'a' interval has passed.
 		MM_TS void intervalDispatch( u64 time );
 
+	private:
+		bool beginAckPacket( class BinSerializer& bs, u64 time );
+
 	private:
 		mutex m_PacketsMutex;
 		u64 m_LastResendTS;
 		vector<u32> m_ReceivedPackets;
+		bool m_HasEcho;
+		u32  m_EchoTimestamp;
+		u64  m_EchoReceivedTS;
 	};
 }
@@ -1,18 +1,48 @@
 #include "ReliableNewRecv.h"
+#include "ReliableNewestAckSend.h"
+#include "Link.h"
+#include "PacketHelper.h"
 
 
 namespace MiepMiep
 {
-
 	ReliableNewRecv::ReliableNewRecv(Link& link):
 		ParentLink(link)
 	{
-
 	}
 
-	void ReliableNewRecv::receive(BinSerializer& bs)
+	MM_TS void ReliableNewRecv::receive( BinSerializer& bs, const PacketInfo& pi )
 	{
+		u32 key;
+		__CHECKED( bs.read( key ) );
+
+		// Also ack old versions, the sender ignores acks of superseded versions.
+		m_Link.getOrAdd<ReliableNewestAckSend>( m_Idx )->addAck( key, pi.m_Sequence );
 
+		if ( !acceptVersion( key, pi.m_Sequence ) )
+			return;
+
+		byte packId;
+		__CHECKED( bs.read( packId ) );
+		// Views the receive buffer, handlers that keep the payload copy it.
+		RecvPacket pack( packId, bs.data()+bs.getRead(), bs.getWrite()-bs.getRead(), pi.m_ChannelAndFlags, false );
+		m_Link.handlePacket( pack );
 	}
 
+	MM_TS bool ReliableNewRecv::acceptVersion( u32 key, u32 version )
+	{
+		scoped_lock lk( m_VersionsMutex );
+		auto vIt = m_Versions.find( key );
+		if ( vIt != m_Versions.end() )
+		{
+			if ( version == vIt->second || !PacketHelper::isSeqNewer( version, vIt->second ) )
+				return false;
+			vIt->second = version;
+		}
+		else
+		{
+			m_Versions[key] = version;
+		}
+		return true;
+	}
 }
\ No newline at end of file
@@ -9,13 +9,24 @@ namespace MiepMiep
 {
 	class Link;
 
-
+	/*
+		Receives reliable newest packets (see ReliableNewSend). Every packet is acked, but a packet is only handled
+		if its version is newer than the last handled version of the same key. Packets of different keys are not ordered.
+	*/
 	class ReliableNewRecv: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		ReliableNewRecv(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableNewRecv; }
 
-		void receive( BinSerializer& bs );
+		MM_TS void receive( class BinSerializer& bs, const struct PacketInfo& pi );
+
+		// True if the version is newer than the last handled version of the key, which it then becomes.
+		// A retransmit of the last handled version is not accepted again.
+		MM_TS bool acceptVersion( u32 key, u32 version );
+
+	private:
+		mutex m_VersionsMutex;
+		map<u32, u32> m_Versions; // Last handled version per key.
 	};
-}
+}
\ No newline at end of file
@@ -1,16 +1,111 @@
 #include "ReliableNewSend.h"
+#include "Link.h"
 #include "LinkStats.h"
+#include "PacketHelper.h"
+#include "Util.h"
 
 
 namespace MiepMiep
 {
 	ReliableNewSend::ReliableNewSend(Link& link):
-		ParentLink(link)
+		ParentLink(link),
+		m_Version(0),
+		m_LastResendTS(0)
 	{
 	}
 
+	MM_TS void ReliableNewSend::enqueue( u32 key, const sptr<const NormalSendPacket>& packet )
+	{
+		assert( packet->m_PayLoad.length() + MM_RELIABLE_NEW_LINK_HDR_SIZE <= MM_MAX_PLPMTU );
+		scoped_lock lk( m_Mutex );
+		Entry& e = m_Entries[key];
+		e.m_Packet  = packet;
+		e.m_Version = m_Version++;
+		e.m_SendTS  = 0;
+		if ( !e.m_Queued )
+		{
+			e.m_Queued = true;
+			m_SendQueue.emplace_back( key );
+		}
+	}
+
+	MM_TS void ReliableNewSend::ack( u32 key, u32 version )
+	{
+		scoped_lock lk( m_Mutex );
+		auto eIt = m_Entries.find( key );
+		// Acks for superseded versions are ignored, the newer version still has to arrive.
+		if ( eIt != m_Entries.end() && eIt->second.m_Version == version )
+		{
+			// A queued key is skipped when its turn comes.
+			m_Entries.erase( eIt );
+		}
+	}
+
 	MM_TS void ReliableNewSend::intervalDispatch( u64 time )
 	{
+		u32 resendDelay = m_Link.getOrAdd<LinkStats>()->reliableResendDelay();
+		scoped_lock lk( m_Mutex );
+		if ( time - m_LastResendTS < MM_ST_RESEND_CHECK_INTERVAL )
+			return;
+		m_LastResendTS = time;
+		for ( auto& kvp : m_Entries )
+		{
+			Entry& e = kvp.second;
+			if ( !e.m_Queued && time - e.m_SendTS >= resendDelay )
+			{
+				e.m_Queued = true;
+				m_SendQueue.emplace_back( kvp.first );
+			}
+		}
+	}
+
+	MM_TS u32 ReliableNewSend::nextSendSize()
+	{
+		scoped_lock lk( m_Mutex );
+		while ( !m_SendQueue.empty() )
+		{
+			auto eIt = m_Entries.find( m_SendQueue.front() );
+			if ( eIt != m_Entries.end() && eIt->second.m_Queued )
+			{
+				return eIt->second.m_Packet->m_PayLoad.length() + MM_RELIABLE_NEW_LINK_HDR_SIZE;
+			}
+			m_SendQueue.pop_front(); // Acked while queued, or queued again after an ack and already sent.
+		}
+		return 0;
+	}
+
+	MM_TS u32 ReliableNewSend::sendNext( u64 time )
+	{
+		sptr<const NormalSendPacket> packet;
+		u32 key, version;
+		{
+			scoped_lock lk( m_Mutex );
+			Entry* e = nullptr;
+			while ( !e && !m_SendQueue.empty() )
+			{
+				key = m_SendQueue.front();
+				m_SendQueue.pop_front();
+				auto eIt = m_Entries.find( key );
+				if ( eIt != m_Entries.end() && eIt->second.m_Queued ) e = &eIt->second;
+			}
+			if ( !e )
+				return 0;
+			e->m_Queued = false;
+			e->m_SendTS = time;
+			packet  = e->m_Packet;
+			version = e->m_Version;
+		}
 
+		// [ version(4) | compType(1) | channelAndFlags(1) | key(4) | dataId(1) | data ]
+		const byte* payLoad = packet->m_PayLoad.data();
+		u32 payLoadLen = packet->m_PayLoad.length();
+		byte finalData[MM_MAX_SENDSIZE];
+		*(u32*)(finalData) = Util::htonl( version );
+		finalData[4] = payLoad[0]; // compType
+		finalData[5] = payLoad[1]; // channelAndFlags
+		*(u32*)(finalData + 6) = Util::htonl( key );
+		Platform::memCpy( finalData + 10, MM_MAX_SENDSIZE-10, payLoad + 2, payLoadLen - 2 );
+		m_Link.send( finalData, payLoadLen + MM_RELIABLE_NEW_LINK_HDR_SIZE );
+		return payLoadLen + MM_RELIABLE_NEW_LINK_HDR_SIZE;
 	}
 }
\ No newline at end of file
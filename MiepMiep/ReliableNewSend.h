@@ -3,29 +3,53 @@
 #include "Memory.h"
 #include "Component.h"
 #include "ParentLink.h"
+#include <deque>
 
 
 namespace MiepMiep
 {
 	class Link;
-
-	struct Block
-	{
-
-	};
-
-	struct BlockList
-	{
-		vector<Block> m_Blocks;
-	};
-
-
+	struct NormalSendPacket;
+
+	/*
+		Reliable newest: Only the latest message per key is kept. Enqueueing a message for a key replaces the older one,
+		whether or not the older one was sent, so an older version is never resent. Each key has at most one packet in flight
+		which is resent every resend delay until its version is acked. Under loss, the bandwidth is therefore bounded by the
+		number of keys and the update rate, not by the backlog.
+		Versions are counted per channel and sent in the sequence field, the key follows the channel and flags.
+		Like the reliable packets, they are pulled by the SendScheduler.
+	*/
 	class ReliableNewSend: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		ReliableNewSend(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableNewSend; }
 
+		MM_TS void enqueue( u32 key, const sptr<const NormalSendPacket>& packet );
+		MM_TS void ack( u32 key, u32 version );
+
+		// Offers keys of which the version went unacked for the resend delay to the scheduler again.
 		MM_TS void intervalDispatch( u64 time );
+
+		// Called by the SendScheduler. Size in bytes on the wire of the next packet to send, 0 if there is nothing to send.
+		MM_TS u32 nextSendSize();
+		// Sends the next packet and returns its size on the wire, 0 if nothing was sent.
+		MM_TS u32 sendNext( u64 time );
+
+	private:
+		struct Entry
+		{
+			sptr<const NormalSendPacket> m_Packet;
+			u32  m_Version;
+			u64  m_SendTS;
+			bool m_Queued; // Key is in the send queue.
+		};
+
+	private:
+		mutex m_Mutex;
+		u32 m_Version;
+		u64 m_LastResendTS;
+		map<u32, Entry> m_Entries; // Unacked latest version per key.
+		deque<u32> m_SendQueue;	   // Keys to send, in order of enqueue.
 	};
-}
+}
\ No newline at end of file
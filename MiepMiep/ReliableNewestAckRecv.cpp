@@ -1,17 +1,26 @@
 #include "ReliableNewestAckRecv.h"
+#include "ReliableNewSend.h"
+#include "Link.h"
+
 
 namespace MiepMiep
 {
-
 	ReliableNewestAckRecv::ReliableNewestAckRecv(Link& link):
 		ParentLink(link)
 	{
-
 	}
 
-	void ReliableNewestAckRecv::receive(class BinSerializer& bs)
+	MM_TS void ReliableNewestAckRecv::receive( BinSerializer& bs )
 	{
-
+		auto rns = m_Link.get<ReliableNewSend>( m_Idx );
+		if ( !rns )
+			return;
+		while ( bs.getRead() != bs.getWrite() )
+		{
+			u32 key, version;
+			__CHECKED( bs.read( key ) );
+			__CHECKED( bs.read( version ) );
+			rns->ack( key, version );
+		}
 	}
-
-}
+}
\ No newline at end of file
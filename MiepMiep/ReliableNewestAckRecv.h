@@ -15,6 +15,6 @@ namespace MiepMiep
 		ReliableNewestAckRecv(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableNewAckRecv; }
 
-		void receive( class BinSerializer& bs );
+		MM_TS void receive( class BinSerializer& bs );
 	};
-}
+}
\ No newline at end of file
@@ -1,13 +1,56 @@
 #include "ReliableNewestAckSend.h"
+#include "Link.h"
+#include "LinkStats.h"
+#include "PerThreadDataProvider.h"
+#include "PacketHelper.h"
 
 
 namespace MiepMiep
 {
-
 	ReliableNewestAckSend::ReliableNewestAckSend(Link& link):
-		ParentLink(link)
+		ParentLink(link),
+		m_LastResendTS(0)
 	{
+	}
 
+	MM_TS void ReliableNewestAckSend::addAck( u32 key, u32 version )
+	{
+		scoped_lock lk( m_AcksMutex );
+		m_Acks.emplace_back( key, version );
 	}
 
-}
+	MM_TS void ReliableNewestAckSend::intervalDispatch( u64 time )
+	{
+		auto stats = m_Link.getOrAdd<LinkStats>();
+		if ( time - m_LastResendTS <= stats->ackAggregateTime() )
+			return;
+		m_LastResendTS = time;
+
+		u32 mtu = stats->mtuAdjusted();
+		auto& bs = PerThreadDataProvider::getSerializer( true );
+		bool hasPendingWrites = false;
+		scoped_lock lk( m_AcksMutex );
+		if ( m_Acks.empty() )
+			return;
+
+		// [ 0(4) | compType(1) | channelAndFlags(1) | (key(4) | version(4))* ]
+		__CHECKED( PacketHelper::beginUnfragmented( bs, 0, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
+		for ( auto& a : m_Acks )
+		{
+			__CHECKED( bs.write( a.first ) );
+			__CHECKED( bs.write( a.second ) );
+			hasPendingWrites = true;
+			if ( bs.length() >= mtu )
+			{
+				m_Link.send( bs.data(), bs.length() );
+				__CHECKED( PacketHelper::beginUnfragmented( bs, 0, (byte)compType(), InvalidByte, (byte)idx(), No_Relay, Do_SysBit ) );
+				hasPendingWrites = false;
+			}
+		}
+		if ( hasPendingWrites )
+		{
+			m_Link.send( bs.data(), bs.length() );
+		}
+		m_Acks.clear();
+	}
+}
\ No newline at end of file
@@ -9,10 +9,22 @@ namespace MiepMiep
 {
 	class Link;
 
+	/*
+		Aggregates the acks of reliable newest packets, like ReliableAckSend does for reliable packets.
+		An ack is the pair of key and version.
+	*/
 	class ReliableNewestAckSend: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		ReliableNewestAckSend(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableNewAckSend; }
+
+		MM_TS void addAck( u32 key, u32 version );
+		MM_TS void intervalDispatch( u64 time );
+
+	private:
+		mutex m_AcksMutex;
+		u64 m_LastResendTS;
+		vector<pair<u32, u32>> m_Acks;
 	};
-}
+}
\ No newline at end of file
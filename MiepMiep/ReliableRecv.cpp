@@ -3,157 +3,284 @@
 #include "Network.h"
 #include "JobSystem.h"
 #include "PerThreadDataProvider.h"
+#include "LinkStats.h"
+#include "Util.h"
+#include <algorithm>
 
 
 namespace MiepMiep
 {
-	// ------ Event --------------------------------------------------------------------------------
-
-	using RpcFunc = void (*)( INetwork&, const ILink&, BinSerializer&, byte );
-
-	struct EventRpc : IEvent
-	{
-		EventRpc(const sptr<Link>& link, const RpcFunc& rpcFunc, const RecvPacket& pack, u32 readPos, bool isSystemRpc):
-			IEvent( link, isSystemRpc),
-			m_RpcFunc(rpcFunc),
-			m_Pack(pack),
-			m_ReadPos(readPos)
-		{
-		}
-
-		void process() override
-		{
-			auto& bs = PerThreadDataProvider::getSerializer(false);
-			bs.resetTo( m_Pack.m_Data, m_Pack.m_Length, m_Pack.m_Length );	
-			bs.setRead( m_ReadPos );
-			m_RpcFunc( m_Link->m_Network, *m_Link, bs, (m_Pack.m_Flags & MM_CHANNEL_MASK) );
-		}
-
-		RpcFunc m_RpcFunc;
-		RecvPacket  m_Pack;
-		u32 m_ReadPos;
-	};
-
-
 	// ------ ReliableRecv --------------------------------------------------------------------------------
 
 	ReliableRecv::ReliableRecv(Link& link):
 		ParentLink(link),
-		m_RecvSequence(0)
+		m_Window(MM_RELIABLE_RECV_WINDOW, MM_RELIABLE_RECV_WINDOW),
+		m_Strand(*link.getInNetwork<JobSystem>()),
+		m_DrainQueued(false)
 	{
 	}
 
-	MM_TS void ReliableRecv::receive(BinSerializer& bs, const PacketInfo& pi)
+	MM_TS bool ReliableRecv::receive(BinSerializer& bs, const PacketInfo& pi)
 	{
-		scoped_lock lk(m_RecvMutex);
-
-		// Early out if out of date.
-		if ( !PacketHelper::isSeqNewer( pi.m_Sequence, m_RecvSequence ) )
+		auto stats = m_Link.getOrAdd<LinkStats>();
+		u32 handledBytes = 0;
 		{
-			return;
-		}
+			scoped_lock lk(m_RecvMutex);
+
+			// Already delivered, ack again as the previous ack may have been lost.
+			if ( !PacketHelper::isSeqNewer( pi.m_Sequence, m_Window.beginSeq() ) )
+			{
+				return true;
+			}
+			// Duplicate of a packet that is already waiting in the window.
+			if ( m_Window.has( pi.m_Sequence ) )
+			{
+				return true;
+			}
 
-//		LOG( "Received reliable seq: %d in link %s.", pi.m_Sequence, m_Link.info() );
+	//		LOG( "Received reliable seq: %d in link %s.", pi.m_Sequence, m_Link.info() );
 
-		// Identifies datatype
-		byte packId;
-		__CHECKED( bs.read(packId) );
+			Slot* slot = m_Window.insert( pi.m_Sequence );
+			if ( !slot )
+			{
+				stats->addRecvWindowDrop();
+				return false;
+			}
 
-		if ( (pi.m_ChannelAndFlags & MM_FRAGMENT_FIRST_BIT)!=0 && (pi.m_ChannelAndFlags & MM_FRAGMENT_LAST_BIT)!=0 ) // not fragmented
-		{
-			// Packet may arrive multiple time as recv_sequence is only incremented when expected sequence is received.
-			m_OrderedPackets.try_emplace( pi.m_Sequence, /* key */
-					make_shared<RecvPacket>( packId, bs.data()+bs.getRead(), bs.getWrite()-bs.getRead(), pi.m_ChannelAndFlags, true), 1 /* value */
-			);
-		}
-		else // fragmented
-		{
-			// Fragment may arrive multiple time as recv_sequence is only incremented when expected sequence is received.
-			pair<decltype(m_OrderedFragments.begin()),bool> inserted = 
-				m_OrderedFragments.try_emplace( pi.m_Sequence, /* key */
-					make_shared<RecvPacket>( packId, bs.data()+bs.getRead(), bs.getWrite()-bs.getRead(), pi.m_ChannelAndFlags, true ) /* value */ );
-
-			if ( !inserted.second )
-				return; // Already exists, nothing to do.
-			
-			// This fragment may have completed the puzzle. Check if all fragments are available to re-assmble big packet.
-			sptr<const RecvPacket> finalPack;
-			u32 seqBegin, seqEnd;
-			if (PacketHelper::tryReassembleBigPacket( finalPack, m_OrderedFragments, pi.m_Sequence, seqBegin, seqEnd ))
+			// Identifies datatype, only the first fragment has it. The first of multiple fragments also describes the message.
+			byte flags	 = pi.m_ChannelAndFlags;
+			bool isFirst = (flags & MM_FRAGMENT_FIRST_BIT) != 0;
+			bool isLast  = (flags & MM_FRAGMENT_LAST_BIT) != 0;
+			byte packId  = InvalidByte;
+			u32  messageLength = 0;
+			u32  numFragments  = 0;
+			if ( isFirst )
+			{
+				if ( !bs.read( packId ) || (!isLast && (!bs.read( messageLength ) || !bs.read( numFragments ))) )
+				{
+					LOGC( "Serialization error!" );
+					m_Window.remove( pi.m_Sequence );
+					return false;
+				}
+				// A message of fewer fragments would never complete and its fragment range would match no sequence.
+				// The message buffer is allocated from the header, so also reject a length its fragments cannot carry.
+				if ( !isLast && (numFragments < 2 || messageLength > (u64)numFragments * MM_MAX_FRAGMENTSIZE) )
+				{
+					LOGW( "Invalid fragmented message of %d bytes in %d fragments in link %s, packet dropped.", messageLength, numFragments, m_Link.info() );
+					m_Window.remove( pi.m_Sequence );
+					return false;
+				}
+			}
+			const byte* data = bs.data()+bs.getRead();
+			u32 len = bs.getWrite()-bs.getRead();
+			slot->m_Flags = flags;
+			slot->m_Done  = false;
+			stats->addReorderBytes( len );
+
+			Message* msg = nullptr;
+			if ( isFirst && isLast )
+			{
+				slot->m_Packet = make_shared<RecvPacket>( packId, data, len, flags, true );
+			}
+			else if ( isFirst )
+			{
+				m_Messages.emplace_back();
+				msg = &m_Messages.back();
+				msg->m_FirstSeq		= pi.m_Sequence;
+				msg->m_NumFragments = numFragments;
+				msg->m_NumPlaced	= 0;
+				msg->m_FirstLength	= len;
+				msg->m_PlacedBytes	= 0;
+				if ( messageLength <= MM_MAX_MESSAGE_SIZE && len <= messageLength )
+				{
+					msg->m_Packet = make_shared<RecvPacket>( packId, messageLength, flags );
+				}
+				else
+				{
+					LOGW( "Invalid fragmented message of %d bytes in %d fragments in link %s, message dropped.", messageLength, numFragments, m_Link.info() );
+				}
+				place( *msg, pi.m_Sequence, data, len );
+
+				// Take the fragments that arrived before the first one out of the window.
+				u32 end = numFragments < m_Window.endSeq() - pi.m_Sequence ? pi.m_Sequence + numFragments : m_Window.endSeq();
+				for ( u32 seq = pi.m_Sequence+1; seq != end; ++seq )
+				{
+					Slot* other = m_Window.get( seq );
+					if ( other && other->m_Packet )
+					{
+						place( *msg, seq, other->m_Packet->m_Data, other->m_Packet->m_Length );
+						other->m_Packet = nullptr;
+					}
+				}
+			}
+			else if ( (msg = findMessage( pi.m_Sequence )) != nullptr )
+			{
+				place( *msg, pi.m_Sequence, data, len );
+			}
+			else
 			{
-				m_OrderedPackets.try_emplace( seqBegin, /* key */
-											  finalPack, 1+(seqEnd-seqBegin) /* value */
-				);
+				slot->m_Packet = make_shared<RecvPacket>( InvalidByte, data, len, flags, true );
+			}
+
+			bool isComplete = msg ? msg->m_NumPlaced == msg->m_NumFragments : (isFirst && isLast);
+			if ( (flags & MM_UNORDERED_BIT) != 0 && isComplete )
+			{
+				handledBytes = handleUnordered( msg ? msg->m_FirstSeq : pi.m_Sequence );
+				if ( handledBytes != 0 )
+				{
+					stats->removeReorderBytes( handledBytes );
+				}
+			}
+
+			// Only schedule a drain if the expected packet is there.
+			if ( !m_Window.has( m_Window.beginSeq() ) )
+			{
+				return true;
 			}
 		}
 
-		// Processed ordered queue as much as possible
-		m_Link.getInNetwork<JobSystem>()->addJob( [rr = move(ptr<ReliableRecv>())]()
+		// Processed ordered queue as much as possible. A drain that is queued but did not start yet also handles this packet.
+		if ( !m_DrainQueued.exchange( true ) )
 		{
-			rr->proceedRecvQueue();
-		});
+			m_Strand.post( [rr = move(ptr<ReliableRecv>())]()
+			{
+				rr->m_DrainQueued = false;
+				rr->proceedRecvQueue();
+			});
+		}
+		return true;
 	}
 
 	MM_TS void ReliableRecv::proceedRecvQueue()
 	{
-		auto& queue = m_OrderedPackets;
-		
-	#if MM_MT
-		scoped_lock lk(m_RecvMutex);
-	#endif
-		auto packIt = queue.find(m_RecvSequence);
-		while ( packIt != queue.end() )
+		u32 drainedBytes = 0;
 		{
-			sptr<const RecvPacket>& pack = packIt->second.first;
-			u32 numFragments = packIt->second.second;
-
-			// -- To ensure that packets remain ordered, no seperate job per packet is allowed. --
-			handlePacket( *pack );
-			queue.erase( packIt );
-			
-			m_RecvSequence += numFragments;
-			// try find next ordered sequence
-			packIt = queue.find(m_RecvSequence);
+		#if MM_MT
+			scoped_lock lk(m_RecvMutex);
+		#endif
+			while ( Slot* slot = m_Window.get( m_Window.beginSeq() ) )
+			{
+				// Unordered messages are left in the window after they are handled, until the window passes them.
+				// An unordered message that is still incomplete is handled by 'receive' once it completes.
+				if ( !slot->m_Done && (slot->m_Flags & MM_UNORDERED_BIT) != 0 )
+					break;
+				u32  seq = m_Window.beginSeq();
+				Slot s	 = move( *slot );
+				m_Window.popFront();
+				if ( s.m_Done )
+					continue;
+
+				// -- To ensure that packets remain ordered, no seperate job per packet is allowed. --
+				bool isFirst = (s.m_Flags & MM_FRAGMENT_FIRST_BIT) != 0;
+				bool isLast  = (s.m_Flags & MM_FRAGMENT_LAST_BIT) != 0;
+				if ( s.m_Packet )
+				{
+					drainedBytes += s.m_Packet->m_Length;
+					if ( isFirst && isLast )
+					{
+						m_Link.handlePacket( *s.m_Packet );
+					}
+					else
+					{
+						LOGW( "Fragment without first fragment in link %s, fragment dropped.", m_Link.info() );
+					}
+					continue;
+				}
+				// Fragment was copied into its message, which is complete once the window passes the last fragment.
+				if ( isLast )
+				{
+					if ( Message* msg = findMessage( seq ) )
+					{
+						drainedBytes += finishMessage( msg->m_FirstSeq );
+					}
+				}
+			}
+		}
+		if ( drainedBytes != 0 )
+		{
+			m_Link.getOrAdd<LinkStats>()->removeReorderBytes( drainedBytes );
 		}
 	}
 
-	MM_TS void ReliableRecv::handlePacket(const RecvPacket& pack)
+	// NOTE: Requires recv lock.
+	ReliableRecv::Message* ReliableRecv::findMessage( u32 seq )
 	{
-		EPacketType pt = sc<EPacketType>( pack.m_Id );
-		switch (pt)
+		for ( auto& msg : m_Messages )
 		{
-		case EPacketType::RPC:
-			handleRpc( pack );
-			break;
+			if ( seq - msg.m_FirstSeq < msg.m_NumFragments )
+			{
+				return &msg;
+			}
+		}
+		return nullptr;
+	}
 
-		case EPacketType::UserOffsetStart:
-			// TODO add event with user data
-			break;
+	// NOTE: Requires recv lock.
+	void ReliableRecv::place( Message& msg, u32 seq, const byte* data, u32 len )
+	{
+		msg.m_NumPlaced++;
+		msg.m_PlacedBytes += len;
+		if ( !msg.m_Packet )
+			return;
 
-		default:
-			LOGW( "Unhandled packet received, data id was %d.", (byte)pt );
-			break;
+		// All fragments in between are full, so the offset follows from the index. The last fragment ends the message.
+		u64 total  = msg.m_Packet->m_Length;
+		u64 idx	   = seq - msg.m_FirstSeq;
+		u64 offset = 0;
+		if ( idx == msg.m_NumFragments-1 )
+		{
+			offset = total - Util::min( (u64)len, total );
+		}
+		else if ( idx != 0 )
+		{
+			offset = msg.m_FirstLength + (idx-1)*len;
 		}
+		if ( offset + len > total || (idx != 0 && offset < msg.m_FirstLength) )
+		{
+			LOGW( "Fragment does not fit in its message in link %s, message dropped.", m_Link.info() );
+			msg.m_Packet = nullptr;
+			return;
+		}
+		Platform::memCpy( msg.m_Packet->m_Data + offset, total - offset, data, len );
 	}
 
-	MM_TS void ReliableRecv::handleRpc(const RecvPacket& pack)
+	// NOTE: Requires recv lock.
+	u32 ReliableRecv::handleUnordered( u32 seq )
 	{
-		auto& bs = PerThreadDataProvider::getSerializer( false );
-		bs.resetTo( pack.m_Data, pack.m_Length, pack.m_Length );
-
-		// TODO optimize this by setting a flag in the packet if the rpc has been resolved to a static ID
-		string rpcName;
-		__CHECKED( bs.read( rpcName ) );
-		void* rpcAddress = priv_get_rpc_func(rpcName);
-		if ( !rpcAddress )
+		// Leave the slots in the window marked done, so that duplicates are still recognized.
+		Slot* slot = m_Window.get( seq );
+		if ( slot && slot->m_Packet )
 		{
-			LOGC( "Cannot find rpc named: %s.", rpcName.c_str() );
-			return;
+			u32 len = slot->m_Packet->m_Length;
+			m_Link.handlePacket( *slot->m_Packet );
+			slot->m_Packet = nullptr;
+			slot->m_Done   = true;
+			return len;
 		}
-		
-//		LOG( "Handling RPC: %s.", rpcName.c_str() );
-		auto rpcFunc = rc<RpcFunc>( rpcAddress );
-		m_Link.pushEvent<EventRpc>( rpcFunc, pack, bs.getRead(), (pack.m_Flags & MM_SYSTEM_BIT) );
+		Message* msg = findMessage( seq );
+		if ( !msg )
+			return 0;
+		for ( u32 i = 0; i < msg->m_NumFragments; ++i )
+		{
+			if ( Slot* s = m_Window.get( seq + i ) )
+			{
+				s->m_Done = true;
+			}
+		}
+		return finishMessage( seq );
 	}
 
+	// NOTE: Requires recv lock.
+	u32 ReliableRecv::finishMessage( u32 firstSeq )
+	{
+		auto mIt = find_if( m_Messages.begin(), m_Messages.end(), [firstSeq] ( const Message& m ) { return m.m_FirstSeq == firstSeq; } );
+		assert( mIt != m_Messages.end() );
+		Message msg = move( *mIt );
+		m_Messages.erase( mIt );
+		if ( msg.m_Packet && msg.m_NumPlaced == msg.m_NumFragments )
+		{
+			m_Link.handlePacket( *msg.m_Packet );
+		}
+		return msg.m_PlacedBytes;
+	}
 }
\ No newline at end of file
@@ -3,29 +3,69 @@
 #include "Memory.h"
 #include "Component.h"
 #include "ParentLink.h"
+#include "SequenceBuffer.h"
+#include "Strand.h"
 
 
 namespace MiepMiep
 {
 	class Link;
-	struct RecvPacket; 
+	struct RecvPacket;
 
 
+	/*
+		Packets are held in a fixed size window indexed by sequence until all packets before them have arrived.
+		Packets beyond the window are dropped and not acked, so the sender resends them later. This caps the memory
+		for reordering per channel at MM_RELIABLE_RECV_WINDOW packets.
+		The first fragment of a fragmented message holds the message length and number of fragments. Once it arrives, the
+		message is allocated and each fragment is copied to its offset as it arrives, leaving only its flags in the window.
+		Fragments that arrive before the first fragment wait in the window until it does. The message is handled when the
+		window passes its last fragment, so a message may consist of more fragments than fit in the window.
+		Packets with the unordered bit are handled as soon as their message is complete. Their slots stay in the window,
+		marked done, until the window passes them, which suppresses duplicates. Unordered messages must fit in the window.
+		Draining the window runs on a strand, so that at most one drain of a link is busy and at most one more is queued,
+		however many packets arrive meanwhile.
+	*/
 	class ReliableRecv: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		ReliableRecv(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableRecv; }
 
-		MM_TS void receive( class BinSerializer& bs, const struct PacketInfo& pi );
+		// Returns false if the packet did not fit in the window and must not be acked.
+		MM_TS bool receive( class BinSerializer& bs, const struct PacketInfo& pi );
 		MM_TS void proceedRecvQueue();
-		MM_TS void handlePacket( const RecvPacket& pack );
-		MM_TS void handleRpc( const RecvPacket& pack );
-		
+
+	private:
+		struct Slot
+		{
+			sptr<const RecvPacket> m_Packet; // Null once the fragment is copied into its message.
+			byte m_Flags = 0;
+			bool m_Done  = false;			 // Unordered message was handled.
+		};
+
+		// A fragmented message of which the first fragment arrived.
+		struct Message
+		{
+			sptr<RecvPacket> m_Packet;		 // Null if a fragment did not fit, the message is then dropped.
+			u32 m_FirstSeq;
+			u32 m_NumFragments;
+			u32 m_NumPlaced;
+			u32 m_FirstLength;				 // All fragments but the first and last have the same length.
+			u32 m_PlacedBytes;
+		};
+
+		Message* findMessage( u32 seq );
+		void place( Message& msg, u32 seq, const byte* data, u32 len );
+		// Return the number of bytes that were handled.
+		u32  handleUnordered( u32 seq );
+		u32  finishMessage( u32 firstSeq );
+
 	private:
 		mutex m_RecvMutex;
-		u32 m_RecvSequence;
-		map<u32, pair<sptr<const RecvPacket>, u32>> m_OrderedPackets;
-		map<u32, sptr<const RecvPacket>> m_OrderedFragments;
+		SequenceBuffer<Slot> m_Window;	// Begins at the next expected sequence.
+		vector<Message> m_Messages;		// Fragmented messages being received, usually very few.
+		Strand m_Strand;
+		atomic<bool> m_DrainQueued;
 	};
-}
+}
\ No newline at end of file
@@ -2,88 +2,306 @@
 #include "Network.h"
 #include "Link.h"
 #include "LinkStats.h"
+#include "FecSend.h"
+#include "PacketHelper.h"
+#include "SessionBase.h"
+#include "NetworkEvents.h"
+#include "RpcRegistry.h"
 #include "Util.h"
+#include <algorithm>
 
 
 namespace MiepMiep
 {
+	// ------ Event --------------------------------------------------------------------------------
+
+	struct EventSendQueueDrained : IEvent
+	{
+		EventSendQueueDrained( const sptr<Link>& link ):
+			IEvent(link, false) { }
+
+		void process() override
+		{
+			if ( !m_Link->getSession() )
+				return;
+			m_Link->getSession()->forListeners( [&] ( ISessionListener* l )
+			{
+				l->onSendQueueDrained( m_Link->session(), *m_Link );
+			});
+		}
+	};
+
+
+	// ------ ReliableSend --------------------------------------------------------------------------------
+
 	ReliableSend::ReliableSend(Link& link):
 		ParentLink(link),
-		m_SendSequence(0),
-		m_LastResendTS(0)
+		m_NextFreshSequence(0),
+		m_SequenceAtLastResend(0),
+		m_PassSequence(0),
+		m_PassEnd(0),
+		m_PassResendDelay(0),
+		m_LastResendTS(0),
+		m_SendQueue(MM_RELIABLE_SEND_WINDOW, MM_MAX_RELIABLE_SEND_WINDOW)
 	{
 	}
 
-	MM_TS void ReliableSend::enqueue( const sptr<const NormalSendPacket>& rsp, class IDeliveryTrace* trace )
+	MM_TS bool ReliableSend::enqueue(const vector<sptr<const NormalSendPacket>>& rsp, class IDeliveryTrace* trace)
 	{
-		scoped_lock lk( m_SendQueueMutex );
-		assert( rsp->m_PayLoad.length() <= MM_MAX_FRAGMENTSIZE );
-		assert( m_SendQueue.count( m_SendSequence ) == 0 );
-		m_SendQueue[m_SendSequence++] = rsp;
+		u32 bytes;
+		{
+			scoped_lock lk(m_SendQueueMutex);
+			if ( !fits( rsp ) )
+				return false;
+			bytes = insert( rsp );
+		}
+		m_Link.getOrAdd<LinkStats>()->addQueuedSend( bytes, (u32)rsp.size() );
+		return true;
 	}
 
-	MM_TS void ReliableSend::enqueue(const vector<sptr<const NormalSendPacket>>& rsp, class IDeliveryTrace* trace)
+	MM_TS bool ReliableSend::enqueueAll( vector<EnqueueTarget>& targets, class IDeliveryTrace* trace )
 	{
-		scoped_lock lk(m_SendQueueMutex);
-		for ( auto& p : rsp )
+		// Lock in address order, so that concurrent sends to overlapping sets of links cannot deadlock.
+		sort( targets.begin(), targets.end(), [] ( const EnqueueTarget& a, const EnqueueTarget& b ) { return a.m_Send < b.m_Send; } );
+		vector<u32> bytes( targets.size() );
 		{
-			assert( p->m_PayLoad.length() <= MM_MAX_FRAGMENTSIZE );
-			assert( m_SendQueue.count( m_SendSequence ) == 0 );
-			m_SendQueue[m_SendSequence++] = p;
+			vector<unique_lock<mutex>> locks;
+			locks.reserve( targets.size() );
+			for ( auto& t : targets )
+			{
+				assert( locks.empty() || t.m_Send != (&t-1)->m_Send );
+				locks.emplace_back( t.m_Send->m_SendQueueMutex );
+			}
+			for ( auto& t : targets )
+			{
+				if ( !t.m_Send->fits( *t.m_Packets ) )
+					return false;
+			}
+			for ( u32 i=0; i<targets.size(); ++i )
+			{
+				bytes[i] = targets[i].m_Send->insert( *targets[i].m_Packets );
+			}
+		}
+		for ( u32 i=0; i<targets.size(); ++i )
+		{
+			targets[i].m_Send->m_Link.getOrAdd<LinkStats>()->addQueuedSend( bytes[i], (u32)targets[i].m_Packets->size() );
 		}
+		return true;
 	}
 
-	MM_TS void ReliableSend::resend()
+	MM_TS void ReliableSend::ackList( const vector<u32>& acks )
 	{
-		scoped_lock lk(m_SendQueueMutex);
-		for ( auto& kvp : m_SendQueue )
+		u32 bytes = 0;
+		u32 packets = 0;
 		{
-			const NormalSendPacket& sendPack = *kvp.second;
+			scoped_lock lk( m_SendQueueMutex );
+			for ( auto seq : acks )
+			{
+				SendEntry* entry = m_SendQueue.get( seq );
+				if ( entry )
+				{
+				//	LOG( "Packet with seq %d in link %s got acked and removed.", seq, m_Link.info() );
+					bytes += entry->m_Packet->m_PayLoad.length();
+					packets++;
+					m_SendQueue.remove( seq );
+				}
+			}
+			m_SendQueue.advanceBegin();
+			//cout << "Link queue size: " << m_SendQueue.count() << endl;
+		}
+		if ( packets == 0 )
+			return;
 
-			// The sequence is specific to each link and packet, all other data in the packet is shared by all links.
-			// Before send, print seq in front of shared data.
-			byte finalData[MM_MAX_SENDSIZE];
-			*(u32*)(finalData) = Util::htonl( kvp.first ); // seq
-			Platform::memCpy( finalData + 4, MM_MAX_SENDSIZE-4, sendPack.m_PayLoad.data(), sendPack.m_PayLoad.length() ); // payload
-			m_Link.send( finalData, sendPack.m_PayLoad.length()+4 );
+		auto stats = m_Link.getOrAdd<LinkStats>();
+		stats->removeQueuedSend( bytes, packets );
+		SessionBase* ses = m_Link.getSession();
+		if ( !ses || !network().hasSessionQueueLimits() )
+		{
+			if ( stats->isSendBlocked() &&
+				 network().isLinkQueueDrained( stats->queuedSendBytes(), stats->queuedSendPackets() ) &&
+				 stats->clearSendBlocked() )
+			{
+				m_Link.pushEvent<EventSendQueueDrained>();
+			}
+			return;
+		}
 
-		//	this_thread::sleep_for( chrono::milliseconds(2) ); // TODO remove
+		// A link blocked by the session limits may have an empty queue of its own and never see an ack,
+		// so acks on any link of the session release all blocked links once the session totals drained.
+		u64 sessionBytes   = 0;
+		u64 sessionPackets = 0;
+		bool anyBlocked    = false;
+		ses->forLink( nullptr, [&]( Link& link )
+		{
+			auto ls = link.getOrAdd<LinkStats>();
+			sessionBytes   += ls->queuedSendBytes();
+			sessionPackets += ls->queuedSendPackets();
+			anyBlocked = anyBlocked || ls->isSendBlocked();
+		});
+		if ( !anyBlocked || !network().isSessionQueueDrained( sessionBytes, sessionPackets ) )
+			return;
+		ses->forLink( nullptr, [&]( Link& link )
+		{
+			auto ls = link.getOrAdd<LinkStats>();
+			if ( ls->isSendBlocked() &&
+				 network().isLinkQueueDrained( ls->queuedSendBytes(), ls->queuedSendPackets() ) &&
+				 ls->clearSendBlocked() )
+			{
+				link.pushEvent<EventSendQueueDrained>();
+			}
+		});
+	}
+
+	MM_TS void ReliableSend::intervalDispatch( u64 time )
+	{
+		u32 delay = m_Link.getOrAdd<LinkStats>()->reliableResendDelay();
+		if ( time - m_LastResendTS > delay )
+		{
+			m_LastResendTS = time;
+			scoped_lock lk( m_SendQueueMutex );
+			m_PassResendDelay = delay;
+			beginResendPass( time );
 		}
 	}
 
-	MM_TS void ReliableSend::ackList( const vector<u32>& acks )
+	MM_TS u32 ReliableSend::numQueued()
+	{
+		scoped_lock lk( m_SendQueueMutex );
+		return m_SendQueue.count();
+	}
+
+	MM_TS u32 ReliableSend::nextSendSize( u64 time )
 	{
 		scoped_lock lk( m_SendQueueMutex );
-		for ( auto seq : acks )
+		u32 seq;
+		SendEntry* entry = nextToSend( time, seq );
+		if ( !entry )
+			return 0;
+		return entry->m_Packet->m_PayLoad.length() + MM_RELIABLE_LINK_HDR_SIZE;
+	}
+
+	MM_TS u32 ReliableSend::sendNext( u64 time )
+	{
+		scoped_lock lk( m_SendQueueMutex );
+		u32 seq;
+		SendEntry* entry = nextToSend( time, seq );
+		if ( !entry )
+			return 0;
+		bool isFresh = seq == m_NextFreshSequence;
+		if ( isFresh )
+			m_NextFreshSequence++;
+		else
+			m_PassSequence++;
+		entry->m_SendTS = time;
+		const NormalSendPacket& sendPack = *entry->m_Packet;
+		send( seq, sendPack, time, isFresh );
+		m_Link.getOrAdd<LinkStats>()->addSentPacket( !isFresh );
+		return sendPack.m_PayLoad.length() + MM_RELIABLE_LINK_HDR_SIZE;
+	}
+
+	bool ReliableSend::fits( const vector<sptr<const NormalSendPacket>>& rsp )
+	{
+		// A partially queued message can never be reassembled on the remote, so check for all fragments first.
+		if ( rsp.size() > m_SendQueue.freeSpace() )
+		{
+			LOGW( "Reliable send window of link %s exceeded %d packets, message of %d fragments not queued.", m_Link.info(), MM_MAX_RELIABLE_SEND_WINDOW, (u32)rsp.size() );
+			return false;
+		}
+		return true;
+	}
+
+	u32 ReliableSend::insert( const vector<sptr<const NormalSendPacket>>& rsp )
+	{
+		u32 bytes = 0;
+		for ( auto& p : rsp )
 		{
-			if ( 0 != m_SendQueue.erase( seq ) )
+			assert( p->m_PayLoad.length() <= MM_MAX_FRAGMENTSIZE );
+			SendEntry* entry = m_SendQueue.insert( m_SendQueue.endSeq() );
+			assert( entry );
+			*entry = { p, 0 };
+			bytes += p->m_PayLoad.length();
+		}
+		return bytes;
+	}
+
+	void ReliableSend::beginResendPass( u64 time )
+	{
+		// The window begins at the oldest unacked packet. If it was already sent before the previous pass,
+		// it went unacked for a full timeout.
+		u32 oldest = m_SendQueue.beginSeq();
+		if ( !m_SendQueue.empty() && !PacketHelper::isSeqNewer( oldest, m_SequenceAtLastResend ) )
+		{
+			m_Link.getOrAdd<LinkStats>()->onResendTimeout();
+		}
+		m_SequenceAtLastResend = m_NextFreshSequence;
+		m_PassSequence = m_SendQueue.empty() ? m_NextFreshSequence : oldest;
+		m_PassEnd = m_NextFreshSequence;
+	}
+
+	ReliableSend::SendEntry* ReliableSend::nextToSend( u64 time, u32& seq )
+	{
+		// Skip what was acked since the pass started.
+		if ( !PacketHelper::isSeqNewer( m_PassSequence, m_SendQueue.beginSeq() ) )
+		{
+			m_PassSequence = PacketHelper::isSeqNewer( m_SendQueue.beginSeq(), m_PassEnd ) ? m_PassEnd : m_SendQueue.beginSeq();
+		}
+		// Acked packets are no longer in the window, recently sent ones wait for the next pass.
+		for ( ; m_PassSequence != m_PassEnd; ++m_PassSequence )
+		{
+			SendEntry* entry = m_SendQueue.get( m_PassSequence );
+			if ( entry && time - entry->m_SendTS >= m_PassResendDelay )
 			{
-			//	LOG( "Packet with seq %d in link %s got acked and removed.", seq, m_Link.info() );
+				seq = m_PassSequence;
+				return entry;
 			}
 		}
-		//cout << "Link queue size: " << m_SendQueue.size() << endl;
+		// The remote drops packets that do not fit in its receive window, so do not send them.
+		if ( m_NextFreshSequence != m_SendQueue.endSeq() && m_NextFreshSequence - m_SendQueue.beginSeq() < MM_RELIABLE_RECV_WINDOW )
+		{
+			seq = m_NextFreshSequence;
+			SendEntry* entry = m_SendQueue.get( seq );
+			assert( entry ); // Cannot be acked as it was never sent.
+			return entry;
+		}
+		return nullptr;
 	}
 
-	MM_TS void ReliableSend::intervalDispatch( u64 time )
+	void ReliableSend::send( u32 seq, const NormalSendPacket& sendPack, u64 time, bool isFresh )
 	{
-		u32 delay = m_Link.getOrAdd<LinkStats>()->reliableResendDelay();
-		if ( time - m_LastResendTS > delay )
+		const byte* payLoad = sendPack.m_PayLoad.data();
+		u32 payLoadLen = sendPack.m_PayLoad.length();
+		assert( payLoadLen >= 2 );
+
+		// The sequence and timestamp are specific to each link and packet, all other data in the packet is shared by all links.
+		// Before send, print seq and timestamp around the compType and channel of the shared data.
+		// [ seq(4) | compType(1) | channelAndFlags(1) | timestamp(4) | <dataId(1)> | data ]
+		byte finalData[MM_MAX_SENDSIZE];
+		*(u32*)(finalData) = Util::htonl( seq );
+		finalData[4] = payLoad[0];
+		finalData[5] = payLoad[1];
+		*(u32*)(finalData + 6) = Util::htonl( (u32)time ); // echoed back in the ack to measure the rtt
+		Platform::memCpy( finalData + 10, MM_MAX_SENDSIZE-10, payLoad + 2, payLoadLen - 2 ); // payload
+		m_Link.send( finalData, payLoadLen + MM_RELIABLE_LINK_HDR_SIZE );
+
+		if ( isFresh && network().channelFec( (byte)idx() ) != EFecMode::None )
 		{
-			m_LastResendTS = time;
-			resend();
+			m_Link.getOrAdd<FecSend>( idx() )->addSource( seq, finalData, payLoadLen + MM_RELIABLE_LINK_HDR_SIZE, time );
 		}
 	}
 
 	// Placed here because RPC is always reliable ordered send.
-	MM_TS ESendCallResult priv_send_rpc(INetwork& nw, const char* rpcName, BinSerializer& payLoad, const ISession* session, ILink* exclOrSpecific, 
+	MM_TS ESendCallResult priv_send_rpc(INetwork& nw, const RpcHeader* rpc, BinSerializer& payLoad, const ISession* session, ILink* exclOrSpecific, 
 										bool buffer, bool relay, bool sysBit, byte channel, IDeliveryTrace* trace)
 	{
 		assert( !buffer || (session) ); // Can only buffer to a session.
-		// Avoid rewriting the entire payload just for the rpc name in front.
-		// Instead, make a seperate serializer for the name and append 2 serializers.
-		BinSerializer bsRpcName;
-		__CHECKEDSR( bsRpcName.write( string(rpcName) ) );
-		const BinSerializer* binSerializers [] = { &bsRpcName, &payLoad };
-		return toNetwork( nw ).sendReliable( (byte)EPacketType::RPC, session, sc<Link*>( exclOrSpecific ), binSerializers, 2, buffer, relay, sysBit, channel, trace );
+		if ( !rpc )
+		{
+			LOGC( "Rpc was not registered or its name hash collides with another rpc, see log at startup." );
+			return ESendCallResult::InternalError;
+		}
+		// Avoid rewriting the entire payload just for the rpc header in front.
+		// Instead, send the cached header of the rpc and the payload as 2 serializers.
+		const BinSerializer* binSerializers [] = { &rpc->m_Unnamed, &payLoad };
+		return toNetwork( nw ).sendReliable( (byte)EPacketType::RPC, session, sc<Link*>( exclOrSpecific ), binSerializers, 2, buffer, relay, sysBit, channel, trace, rpc );
 	}
 }
\ No newline at end of file
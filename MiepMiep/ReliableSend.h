@@ -3,6 +3,7 @@
 #include "Memory.h"
 #include "Component.h"
 #include "ParentLink.h"
+#include "SequenceBuffer.h"
 #include <atomic>
 
 
@@ -12,25 +13,63 @@ namespace MiepMiep
 	struct NormalSendPacket;
 
 
+	/*
+		Reliable packets are not sent directly on enqueue. The SendScheduler of the link pulls them,
+		so that channels can be prioritized against each other. Each resend interval, a resend pass is started
+		in which all packets that went unacked for at least the resend delay are offered to the scheduler again.
+		Resends go before packets that were never sent, as they hold up ordered delivery on the remote.
+	*/
 	class ReliableSend: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		ReliableSend(Link& link);
 		static EComponentType compType() { return EComponentType::ReliableSend; }
 
+		struct EnqueueTarget
+		{
+			ReliableSend* m_Send;
+			const vector<sptr<const NormalSendPacket>>* m_Packets;
+		};
+
 		// TODO impl trace
-		MM_TS void enqueue( const sptr<const NormalSendPacket>& rsp, class IDeliveryTrace* trace );
-		MM_TS void enqueue( const vector<sptr<const NormalSendPacket>>& rsp, class IDeliveryTrace* trace );
-		MM_TS void resend();
+		// The fragments of a message are queued all or none. Returns false if they do not fit in the send window.
+		MM_TS bool enqueue( const vector<sptr<const NormalSendPacket>>& rsp, class IDeliveryTrace* trace );
+		// Queues a message on multiple links, on all or on none. The send windows of all are locked at once.
+		MM_TS static bool enqueueAll( vector<EnqueueTarget>& targets, class IDeliveryTrace* trace );
 		MM_TS void ackList( const vector<u32>& acks );
+		// Packets that are not acked yet.
+		MM_TS u32  numQueued();
 
-		// Resend only if 'a' interval has passed.
+		// Starts a resend pass only if 'a' interval has passed.
 		MM_TS void intervalDispatch( u64 time );
 
+		// Called by the SendScheduler. Size in bytes on the wire of the next packet to send, 0 if there is nothing to send.
+		MM_TS u32 nextSendSize( u64 time );
+		// Sends the next packet and returns its size on the wire, 0 if nothing was sent.
+		MM_TS u32 sendNext( u64 time );
+
+	private:
+		struct SendEntry
+		{
+			sptr<const NormalSendPacket> m_Packet;
+			u64 m_SendTS;
+		};
+
+		// NOTE: All require the send queue lock.
+		bool fits( const vector<sptr<const NormalSendPacket>>& rsp );
+		u32  insert( const vector<sptr<const NormalSendPacket>>& rsp ); // Returns the queued bytes.
+		void beginResendPass( u64 time );
+		SendEntry* nextToSend( u64 time, u32& seq );
+		void send( u32 seq, const NormalSendPacket& sendPack, u64 time, bool isFresh );
+
 	private:
 		mutex m_SendQueueMutex;
-		u32 m_SendSequence;
+		u32 m_NextFreshSequence;	// First packet that was never sent.
+		u32 m_SequenceAtLastResend;
+		u32 m_PassSequence;			// Next packet to consider in the current resend pass.
+		u32 m_PassEnd;
+		u32 m_PassResendDelay;
 		atomic<u64> m_LastResendTS;
-		map<u32, sptr<const NormalSendPacket>> m_SendQueue;
+		SequenceBuffer<SendEntry> m_SendQueue; // Unacked packets, the next enqueued packet gets its 'endSeq'.
 	};
-}
+}
\ No newline at end of file
@@ -16,29 +16,45 @@ namespace MiepMiep
 		readOrWrite<T> ( bs, te, write );
 		serialize<N+1, TP, Args...>( bs, write, tp );
 	}
+
+	// Writes the arguments of an outgoing rpc straight from the caller's references.
+	inline void serializeArgs(BinSerializer& bs) { }
+	template <typename T, typename ...Args>
+	void serializeArgs(BinSerializer& bs, const T& arg, const Args&... args)
+	{
+		readOrWrite<T>( bs, const_cast<T&>(arg), true ); // Writing leaves the argument untouched.
+		serializeArgs( bs, args... );
+	}
+
+	// Rpc bodies receive their arguments as a tuple of references, so that local calls do not copy them.
+	// Arguments of a different type than declared are converted to temporaries that live until the call returns.
+	template <typename ...Params>
+	using RpcArgs = std::tuple<const Params&...>;
+	template <typename ...Params>
+	RpcArgs<Params...> rpcArgRefs(const Params&... params) { return RpcArgs<Params...>( params... ); }
 }
 
 
 #define MM_RPC(name, ...) \
-inline void rpc_tuple_##name( INetwork& network, const ILink* link, byte channel, const std::tuple<__VA_ARGS__>& tp ); \
+inline void rpc_tuple_##name( INetwork& network, const ILink* link, byte channel, const MiepMiep::RpcArgs<__VA_ARGS__>& tp ); \
 struct name { \
 inline static const char* rpcName() { return #name; } \
+constexpr static u32 rpcHash() { return priv_hash_name( #name ); } \
+inline static const RpcHeader* rpcHeader() { static const RpcHeader* hdr = priv_get_rpc_header( rpcHash() ); return hdr; } \
 template <typename ...Args> \
-inline static void rpc(Args... args, INetwork& network, BinSerializer& bs, bool localCall, byte channel )\
+inline static void rpc(const Args&... args, INetwork& network, BinSerializer& bs, bool localCall, byte channel )\
 { \
-	std::tuple<Args...> tp(args...); \
-	MiepMiep::serialize<0, std::tuple<Args...>, Args...>( bs, true, tp ); \
-	if ( localCall ) rpc_tuple_##name( network, nullptr, channel, tp ); \
+	MiepMiep::serializeArgs( bs, args... ); \
+	if ( localCall ) rpc_tuple_##name( network, nullptr, channel, MiepMiep::rpcArgRefs<__VA_ARGS__>( args... ) ); \
 }};\
-extern "C" {\
-inline void MM_DLL_EXPORT rpc_dsr_##name(INetwork& network, const ILink& link, BinSerializer& bs, byte channel)\
+inline void rpc_dsr_##name(INetwork& network, const ILink& link, BinSerializer& bs, byte channel)\
 { \
 	std::tuple<__VA_ARGS__> tp; \
 	MiepMiep::serialize<0, std::tuple<__VA_ARGS__>, __VA_ARGS__>( bs, false, tp ); \
 	rpc_tuple_##name( network, &link, channel, tp ); \
 } \
-}\
-void rpc_tuple_##name(INetwork& network, const ILink* link, byte channel, const std::tuple<__VA_ARGS__>& tp)
+static const u32 rpc_reg_##name = priv_register_rpc( name::rpcHash(), #name, &rpc_dsr_##name ); \
+void rpc_tuple_##name(INetwork& network, const ILink* link, byte channel, const MiepMiep::RpcArgs<__VA_ARGS__>& tp)
 
 
 #define MM_VARGROUP(name, ...) \
@@ -0,0 +1,76 @@
+#include "RpcIdTable.h"
+#include "Link.h"
+#include "Network.h"
+#include "Rpc.h"
+#include "RpcRegistry.h"
+
+
+namespace MiepMiep
+{
+	// ------ Rpc --------------------------------------------------------------------------------
+
+	MM_RPC( rpcIdConfirm, u32 )
+	{
+		RPC_BEGIN_NO_S();
+		l.getOrAdd<RpcIdTable>()->confirm( get<0>( tp ) );
+	}
+
+
+	// ------ RpcIdTable --------------------------------------------------------------------------------
+
+	RpcIdTable::RpcIdTable(Link& link):
+		ParentLink(link)
+	{
+	}
+
+	MM_TS bool RpcIdTable::isConfirmed( u32 id )
+	{
+		scoped_lock lk( m_SendMutex );
+		return id < m_Confirmed.size() && m_Confirmed[id];
+	}
+
+	MM_TS void RpcIdTable::confirm( u32 id )
+	{
+		if ( id >= MM_MAX_RPC_IDS )
+		{
+			LOGW( "Rpc id %d confirmed by %s is out of range.", id, m_Link.info() );
+			return;
+		}
+		scoped_lock lk( m_SendMutex );
+		if ( id >= m_Confirmed.size() )
+		{
+			m_Confirmed.resize( id+1, false );
+		}
+		m_Confirmed[id] = true;
+	}
+
+	MM_TS RpcFunc RpcIdTable::define( u32 id, u32 hash )
+	{
+		if ( id >= MM_MAX_RPC_IDS )
+		{
+			LOGW( "Rpc id %d for hash %x from %s is out of range.", id, hash, m_Link.info() );
+			return nullptr;
+		}
+		RpcFunc func = RpcRegistry::find( hash );
+		if ( !func )
+			return nullptr;
+		{
+			scoped_lock lk( m_RecvMutex );
+			if ( id < m_Funcs.size() && m_Funcs[id] == func )
+				return func; // Already confirmed, a message sent before the confirmation arrived.
+			if ( id >= m_Funcs.size() )
+			{
+				m_Funcs.resize( id+1, nullptr );
+			}
+			m_Funcs[id] = func;
+		}
+		m_Link.callRpc<rpcIdConfirm, u32>( id, No_Local, No_Relay, MM_RPC_CHANNEL, No_Trace );
+		return func;
+	}
+
+	MM_TS RpcFunc RpcIdTable::find( u32 id )
+	{
+		scoped_lock lk( m_RecvMutex );
+		return id < m_Funcs.size() ? m_Funcs[id] : nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+#include "RpcRegistry.h"
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Rpcs are identified by their index in the RpcRegistry of this process, so both sides of a link do not need to agree on them.
+		Until the remote confirmed that it resolved an index, the hash of the rpc name is sent along. The remote then looks up
+		the hash once and afterwards finds the rpc by index. Buffered messages always carry the hash as they are delivered to
+		links that join later.
+	*/
+	class RpcIdTable: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		RpcIdTable(Link& link);
+		static EComponentType compType() { return EComponentType::RpcIdTable; }
+
+		// Send side, ids of this process.
+		MM_TS bool isConfirmed( u32 id );
+		MM_TS void confirm( u32 id );
+
+		// Receive side, ids of the remote. Define resolves the hash and confirms the id to the remote.
+		MM_TS RpcFunc define( u32 id, u32 hash );
+		MM_TS RpcFunc find( u32 id );
+
+	private:
+		mutex m_SendMutex;
+		mutex m_RecvMutex;
+		vector<bool>  m_Confirmed;
+		vector<RpcFunc> m_Funcs;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "RpcRegistry.h"
+#include "Platform.h"
+#include <cstring>
+
+
+namespace MiepMiep
+{
+	// ------ RpcHeader --------------------------------------------------------------------------------
+
+	bool RpcHeader::write( u32 id, u32 hash )
+	{
+		// Remotes reject larger ids, also keeps id<<1 from overflowing.
+		if ( id >= MM_MAX_RPC_IDS )
+			return false;
+		m_Id = id;
+		__CHECKEDB( m_Unnamed.writeVarint( id<<1 ) );
+		__CHECKEDB( m_Named.writeVarint( (id<<1) | 1 ) );
+		__CHECKEDB( m_Named.write( hash ) );
+		return true;
+	}
+
+
+	// ------ RpcRegistry --------------------------------------------------------------------------------
+
+	RpcRegistry::Table& RpcRegistry::table()
+	{
+		static Table t;
+		return t;
+	}
+
+	MM_TS u32 RpcRegistry::add( u32 hash, const char* name, RpcFunc func )
+	{
+		Table& t = table();
+		scoped_lock lk( t.m_Mutex );
+		auto it = t.m_HashToIndex.find( hash );
+		if ( it != t.m_HashToIndex.end() )
+		{
+			// Same rpc registered from several translation units is fine, a different name with the same hash is not.
+			// Neither rpc can then be told apart on the wire, so both are disabled.
+			Entry& e = t.m_Entries[it->second];
+			if ( strcmp( e.m_Name, name ) == 0 )
+				return it->second;
+			LOGC( "Rpc names %s and %s have the same hash, rename one. Calls to either fail.", e.m_Name, name );
+			e.m_Collided = true;
+			return MM_INVALID_RPC_ID;
+		}
+		u32 idx = (u32)t.m_Entries.size();
+		auto hdr = make_shared<RpcHeader>();
+		if ( !hdr->write( idx, hash ) )
+		{
+			LOGC( "Cannot register rpc %s, more than %d rpcs are registered.", name, MM_MAX_RPC_IDS );
+			return MM_INVALID_RPC_ID;
+		}
+		t.m_Entries.push_back( { name, func, hdr, false } );
+		t.m_HashToIndex.insert( std::make_pair( hash, idx ) );
+		return idx;
+	}
+
+	MM_TS RpcFunc RpcRegistry::find( u32 hash )
+	{
+		Table& t = table();
+		scoped_lock lk( t.m_Mutex );
+		auto it = t.m_HashToIndex.find( hash );
+		if ( it == t.m_HashToIndex.end() || t.m_Entries[it->second].m_Collided )
+			return nullptr;
+		return t.m_Entries[it->second].m_Func;
+	}
+
+	MM_TS const RpcHeader* RpcRegistry::header( u32 hash )
+	{
+		Table& t = table();
+		scoped_lock lk( t.m_Mutex );
+		auto it = t.m_HashToIndex.find( hash );
+		if ( it == t.m_HashToIndex.end() || t.m_Entries[it->second].m_Collided )
+			return nullptr;
+		return t.m_Entries[it->second].m_Header.get();
+	}
+
+
+	// To get from user code to the registry -->
+
+	MM_TS u32 priv_register_rpc(u32 hash, const char* name, RpcFunc func)
+	{
+		return RpcRegistry::add( hash, name, func );
+	}
+
+	MM_TS RpcFunc priv_get_rpc_func(u32 hash)
+	{
+		return RpcRegistry::find( hash );
+	}
+
+	MM_TS const RpcHeader* priv_get_rpc_header(u32 hash)
+	{
+		return RpcRegistry::header( hash );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Common.h"
+#include "Memory.h"
+#include "BinSerializer.h"
+#include <unordered_map>
+#include <vector>
+
+
+namespace MiepMiep
+{
+	// The rpc header in front of the payload is a varint of (id<<1 | hasHash), followed by the name hash if the bit is set.
+	// Both forms are encoded once at registration, so sending an rpc only appends the cached bytes.
+	struct RpcHeader
+	{
+		u32 m_Id;
+		BinSerializer m_Unnamed;
+		BinSerializer m_Named;
+
+		bool write( u32 id, u32 hash );
+	};
+
+	/*
+		Every MM_RPC and MM_VARGROUP registers itself here during static initialization under the FNV-1a hash of its name,
+		which is computed at compile time. Entries also get a small index in order of registration, used as the rpc id
+		on the wire (see RpcIdTable). Names whose hashes collide are reported at registration and both rpcs are disabled.
+	*/
+	class RpcRegistry
+	{
+	public:
+		MM_TS static u32 add( u32 hash, const char* name, RpcFunc func );
+		// Both return nullptr if no rpc was registered with the hash, or if the names of several rpcs share the hash.
+		MM_TS static RpcFunc find( u32 hash );
+		// The header lives as long as the process.
+		MM_TS static const RpcHeader* header( u32 hash );
+
+	private:
+		struct Entry
+		{
+			const char* m_Name;
+			RpcFunc m_Func;
+			sptr<const RpcHeader> m_Header; // Shared so that it does not move when the table grows.
+			bool m_Collided;				// Another name has the same hash.
+		};
+
+		struct Table
+		{
+			mutex m_Mutex;
+			std::unordered_map<u32, u32> m_HashToIndex;
+			vector<Entry> m_Entries;
+		};
+
+		// Function local, so that it is constructed before the first registration regardless of translation unit order.
+		static Table& table();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "SendScheduler.h"
+#include "Link.h"
+#include "Network.h"
+#include "ReliableSend.h"
+#include "ReliableNewSend.h"
+#include "UnreliableSend.h"
+#include "Util.h"
+
+
+namespace MiepMiep
+{
+	SendScheduler::SendScheduler(Link& link):
+		ParentLink(link),
+		m_Tokens(0),
+		m_LastRefillTS(0),
+		m_NextChannel(0)
+	{
+		for ( auto& d : m_Deficit ) d = 0;
+	}
+
+	void SendScheduler::dispatch( u64 time )
+	{
+		Network& nw = network();
+
+		// Refill the token bucket.
+		u32 rate = nw.linkSendRate();
+		if ( rate != 0 )
+		{
+			i64 burst = Util::max( (i64)rate * MM_SCHEDULER_BURST_TIME / 1000, (i64)MM_MAX_PLPMTU );
+			if ( m_LastRefillTS != 0 )
+			{
+				m_Tokens += (i64)rate * (i64)(time - m_LastRefillTS) / 1000;
+			}
+			m_Tokens = Util::min( m_Tokens, burst );
+			m_LastRefillTS = time;
+			if ( !hasBudget() )
+				return;
+		}
+
+		// Gather channels that have something to send, sorted by priority class. Channels keep their index order
+		// within a class, starting from the channel that was interrupted last.
+		ChannelSenders senders[MM_NUM_CHANNELS];
+		byte channels[MM_NUM_CHANNELS];
+		u32  numChannels = 0;
+		for ( u32 i=0; i<MM_NUM_CHANNELS; ++i )
+		{
+			byte ch = (byte)((m_NextChannel + i) % MM_NUM_CHANNELS);
+			senders[ch].m_Unreliable  = m_Link.get<UnreliableSend>( ch );
+			senders[ch].m_ReliableNew = m_Link.get<ReliableNewSend>( ch );
+			senders[ch].m_Reliable    = m_Link.get<ReliableSend>( ch );
+			if ( 0 == senders[ch].nextSendSize( time ) )
+			{
+				senders[ch].reset();
+				m_Deficit[ch] = 0; // Idle channels cannot save up bandwidth.
+				continue;
+			}
+			u32 prio = nw.channelPriority( ch );
+			u32 j = numChannels++;
+			for ( ; j > 0 && nw.channelPriority( channels[j-1] ) > prio; --j )
+			{
+				channels[j] = channels[j-1];
+			}
+			channels[j] = ch;
+		}
+
+		// Strict priority between classes.
+		u32 classBegin = 0;
+		while ( classBegin < numChannels )
+		{
+			u32 prio = nw.channelPriority( channels[classBegin] );
+			u32 classEnd = classBegin+1;
+			while ( classEnd < numChannels && nw.channelPriority( channels[classEnd] ) == prio ) classEnd++;
+			if ( !serveClass( channels + classBegin, classEnd - classBegin, senders, time ) )
+				return;
+			classBegin = classEnd;
+		}
+	}
+
+	bool SendScheduler::hasBudget()
+	{
+		// A single packet may overdraw the bucket, so that packets bigger than the burst size can still be sent.
+		return network().linkSendRate() == 0 || m_Tokens > 0;
+	}
+
+	// Deficit round robin. Returns false if the link ran out of budget.
+	bool SendScheduler::serveClass( const byte* channels, u32 numChannels, ChannelSenders* senders, u64 time )
+	{
+		Network& nw = network();
+		bool hasPending = true;
+		while ( hasPending )
+		{
+			hasPending = false;
+			for ( u32 i=0; i<numChannels; ++i )
+			{
+				byte ch = channels[i];
+				auto& cs = senders[ch];
+				if ( !cs.active() ) continue;
+
+				u32 size = cs.nextSendSize( time );
+				// Only add a quantum if the head packet does not fit. A channel that was interrupted due to lack of
+				// budget still has its deficit and does not get a second quantum in the same round.
+				if ( size != 0 && size > m_Deficit[ch] )
+				{
+					m_Deficit[ch] += MM_SCHEDULER_QUANTUM * Util::max( nw.channelWeight( ch ), (u32)1 );
+				}
+				while ( size != 0 && size <= m_Deficit[ch] )
+				{
+					if ( !hasBudget() )
+					{
+						m_NextChannel = ch;
+						return false;
+					}
+					u32 sent = cs.sendNext( time );
+					m_Deficit[ch] -= Util::min( sent, m_Deficit[ch] );
+					m_Tokens -= sent;
+					size = cs.nextSendSize( time );
+				}
+				if ( size == 0 )
+				{
+					m_Deficit[ch] = 0;
+					cs.reset();
+				}
+				else
+				{
+					hasPending = true;
+				}
+			}
+		}
+		return true;
+	}
+
+	u32 SendScheduler::ChannelSenders::nextSendSize( u64 time ) const
+	{
+		u32 size = m_Unreliable ? m_Unreliable->nextSendSize() : 0;
+		if ( size == 0 && m_ReliableNew )
+		{
+			size = m_ReliableNew->nextSendSize();
+		}
+		if ( size == 0 && m_Reliable )
+		{
+			size = m_Reliable->nextSendSize( time );
+		}
+		return size;
+	}
+
+	u32 SendScheduler::ChannelSenders::sendNext( u64 time ) const
+	{
+		u32 sent = m_Unreliable ? m_Unreliable->sendNext() : 0;
+		if ( sent == 0 && m_ReliableNew )
+		{
+			sent = m_ReliableNew->sendNext( time );
+		}
+		if ( sent == 0 && m_Reliable )
+		{
+			sent = m_Reliable->sendNext( time );
+		}
+		return sent;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+
+
+namespace MiepMiep
+{
+	class Link;
+	class ReliableSend;
+	class ReliableNewSend;
+	class UnreliableSend;
+
+	/*
+		Decides which channel of a link may send next.
+		Channels are grouped in priority classes (see INetwork::setChannelPriority). A class is only served when all
+		classes with a lower number have nothing left to send. Within a class, channels share the link by deficit round robin,
+		each channel receiving bandwidth in proportion to its weight.
+		The amount a link may send is limited by a token bucket (see INetwork::setLinkSendRate). When the link is not
+		rate limited, everything is sent each dispatch and the classes only determine the order.
+		Acks and mtu probes do not pass through the scheduler.
+		NOTE: Not thread safe, only accessed from the SendThread.
+	*/
+	class SendScheduler: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		SendScheduler(Link& link);
+		static EComponentType compType() { return EComponentType::SendScheduler; }
+
+		void dispatch( u64 time );
+
+	private:
+		// The senders of a single channel. Unreliable packets go first as they turn stale quickly, then the latest state,
+		// then the ordered reliable stream.
+		struct ChannelSenders
+		{
+			sptr<UnreliableSend>  m_Unreliable;
+			sptr<ReliableNewSend> m_ReliableNew;
+			sptr<ReliableSend>    m_Reliable;
+
+			u32  nextSendSize( u64 time ) const;
+			u32  sendNext( u64 time ) const;
+			bool active() const { return m_Unreliable || m_ReliableNew || m_Reliable; }
+			void reset() { m_Unreliable = nullptr; m_ReliableNew = nullptr; m_Reliable = nullptr; }
+		};
+
+		bool hasBudget();
+		bool serveClass( const byte* channels, u32 numChannels, ChannelSenders* senders, u64 time );
+
+	private:
+		i64  m_Tokens;
+		u64  m_LastRefillTS;
+		u32  m_Deficit[MM_NUM_CHANNELS];
+		byte m_NextChannel; // Channel to resume from when the budget ran out halfway a round.
+	};
+}
\ No newline at end of file
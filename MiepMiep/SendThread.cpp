@@ -5,6 +5,11 @@
 #include "ReliableSend.h"
 #include "ReliableNewSend.h"
 #include "ReliableAckSend.h"
+#include "ReliableNewestAckSend.h"
+#include "MtuDiscovery.h"
+#include "FecSend.h"
+#include "StreamSend.h"
+#include "SendScheduler.h"
 #include "Util.h"
 #include "Platform.h"
 using namespace chrono;
@@ -66,7 +71,15 @@ namespace MiepMiep
 			{
 				intervalDispatchOnAllChannels<ReliableSend>( link, time );
 				intervalDispatchOnAllChannels<ReliableNewSend>( link, time );
+				intervalDispatchOnAllChannels<StreamSend>( link, time );
+				if ( auto sched = link.get<SendScheduler>() )
+				{
+					sched->dispatch( time );
+				}
 				intervalDispatchOnAllChannels<ReliableAckSend>( link, time );
+				intervalDispatchOnAllChannels<ReliableNewestAckSend>( link, time );
+				intervalDispatchOnAllChannels<FecSend>( link, time );
+				intervalDispatchOnAllChannels<MtuDiscovery>( link, time );
 			}, MM_ST_LINKS_CLUSTER_SIZE );
 		}
 	}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Common.h"
+#include <vector>
+
+
+namespace MiepMiep
+{
+	/*
+		Window of entries indexed by sequence number, stored in a power of two ring buffer at 'seq & mask'.
+		The window spans [beginSeq, endSeq). A bitmap tells which sequences in the window hold an entry,
+		so inserting, finding and removing an entry are O(1) and walking the window reads contiguous memory.
+		If 'maxCapacity' is larger than the initial capacity, the buffer doubles in size when a sequence falls outside it.
+		Sequences wrap around, the window must stay smaller than MM_NEWER_SEQ_RANGE.
+		NOTE: Not thread safe.
+	*/
+	template <typename T>
+	class SequenceBuffer
+	{
+	public:
+		SequenceBuffer(u32 capacity, u32 maxCapacity, u32 beginSeq=0);
+
+		u32  beginSeq() const	{ return m_Begin; }
+		u32  endSeq() const		{ return m_End; }
+		u32  count() const		{ return m_Count; }
+		u32  capacity() const	{ return m_Mask+1; }
+		bool empty() const		{ return m_Count == 0; }
+		// Number of sequences from endSeq on that can still be inserted without exceeding max capacity.
+		u32  freeSpace() const	{ return m_MaxCapacity - (m_End - m_Begin); }
+
+		bool has( u32 seq ) const;
+		T*   get( u32 seq );
+		const T* get( u32 seq ) const;
+
+		// Returns nullptr if the entry already exists, or if the sequence is older than the window or does not fit in max capacity.
+		T*   insert( u32 seq );
+		bool remove( u32 seq );
+
+		// Moves the begin of the window forward past removed entries.
+		void advanceBegin();
+		// Removes the first entry in the window, if any, and moves the begin one forward.
+		void popFront();
+
+	private:
+		bool inWindow( u32 seq ) const { return seq - m_Begin < m_End - m_Begin; }
+		bool isSet( u32 seq ) const { u32 i = seq & m_Mask; return (m_Occupied[i>>6] & (1ULL << (i&63))) != 0; }
+		void set( u32 seq )			{ u32 i = seq & m_Mask; m_Occupied[i>>6] |=  (1ULL << (i&63)); }
+		void clear( u32 seq )		{ u32 i = seq & m_Mask; m_Occupied[i>>6] &= ~(1ULL << (i&63)); }
+		bool grow( u32 span );
+
+	private:
+		u32 m_Begin;
+		u32 m_End;
+		u32 m_Count;
+		u32 m_Mask;
+		u32 m_MaxCapacity;
+		vector<T>   m_Entries;
+		vector<u64> m_Occupied;
+	};
+
+
+	template <typename T>
+	SequenceBuffer<T>::SequenceBuffer(u32 capacity, u32 maxCapacity, u32 beginSeq):
+		m_Begin(beginSeq),
+		m_End(beginSeq),
+		m_Count(0),
+		m_MaxCapacity(maxCapacity)
+	{
+		assert( capacity >= 64 && (capacity & (capacity-1)) == 0 && (maxCapacity & (maxCapacity-1)) == 0 && maxCapacity >= capacity );
+		m_Mask = capacity-1;
+		m_Entries.resize( capacity );
+		m_Occupied.resize( capacity/64, 0 );
+	}
+
+	template <typename T>
+	bool SequenceBuffer<T>::has( u32 seq ) const
+	{
+		return inWindow( seq ) && isSet( seq );
+	}
+
+	template <typename T>
+	T* SequenceBuffer<T>::get( u32 seq )
+	{
+		return has( seq ) ? &m_Entries[seq & m_Mask] : nullptr;
+	}
+
+	template <typename T>
+	const T* SequenceBuffer<T>::get( u32 seq ) const
+	{
+		return has( seq ) ? &m_Entries[seq & m_Mask] : nullptr;
+	}
+
+	template <typename T>
+	T* SequenceBuffer<T>::insert( u32 seq )
+	{
+		u32 span = seq - m_Begin + 1;
+		if ( span > MM_NEWER_SEQ_RANGE )
+			return nullptr; // older than the window
+		if ( span > capacity() && !grow( span ) )
+			return nullptr;
+		if ( inWindow( seq ) )
+		{
+			if ( isSet( seq ) )
+				return nullptr;
+		}
+		else
+		{
+			m_End = seq+1;
+		}
+		set( seq );
+		m_Count++;
+		return &m_Entries[seq & m_Mask];
+	}
+
+	template <typename T>
+	bool SequenceBuffer<T>::remove( u32 seq )
+	{
+		if ( !has( seq ) )
+			return false;
+		clear( seq );
+		m_Entries[seq & m_Mask] = T(); // Release held resources now.
+		m_Count--;
+		return true;
+	}
+
+	template <typename T>
+	void SequenceBuffer<T>::advanceBegin()
+	{
+		while ( m_Begin != m_End && !isSet( m_Begin ) )
+		{
+			m_Begin++;
+		}
+	}
+
+	template <typename T>
+	void SequenceBuffer<T>::popFront()
+	{
+		remove( m_Begin );
+		m_Begin++;
+		if ( m_End - m_Begin > MM_NEWER_SEQ_RANGE ) // Window was empty.
+		{
+			m_End = m_Begin;
+		}
+	}
+
+	template <typename T>
+	bool SequenceBuffer<T>::grow( u32 span )
+	{
+		u32 newCapacity = capacity();
+		while ( newCapacity < span )
+		{
+			if ( newCapacity >= m_MaxCapacity )
+				return false;
+			newCapacity *= 2;
+		}
+		vector<T>   entries( newCapacity );
+		vector<u64> occupied( newCapacity/64, 0 );
+		u32 newMask = newCapacity-1;
+		for ( u32 seq = m_Begin; seq != m_End; ++seq )
+		{
+			if ( isSet( seq ) )
+			{
+				u32 i = seq & newMask;
+				entries[i] = std::move( m_Entries[seq & m_Mask] );
+				occupied[i>>6] |= (1ULL << (i&63));
+			}
+		}
+		m_Entries.swap( entries );
+		m_Occupied.swap( occupied );
+		m_Mask = newMask;
+		return true;
+	}
+}
\ No newline at end of file
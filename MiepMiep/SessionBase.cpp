@@ -53,11 +53,7 @@ namespace MiepMiep
 	void SessionBase::bufferMsg( const vector<sptr<const NormalSendPacket>>& data, byte channel )
 	{
 		assert( channel <= MM_CHANNEL_MASK );
-		auto& buffQueue = m_BufferedPackets[channel];
-		for ( auto& dataPack : data )
-		{
-			buffQueue.emplace_back( dataPack );
-		}
+		m_BufferedMessages[channel].emplace_back( data );
 	}
 
 	bool SessionBase::addLink( const sptr<Link>& link )
@@ -69,9 +65,14 @@ namespace MiepMiep
 		for ( u32 ch=0; ch<MM_NUM_CHANNELS; ch++)
 		{
 			sptr<ReliableSend> rd = link->getOrAdd<ReliableSend>( ch );
-			for ( auto& buffPack : m_BufferedPackets[ch] )
+			// Each message is queued whole. Stop at the first that does not fit, to keep the rest in order.
+			for ( auto& buffMsg : m_BufferedMessages[ch] )
 			{
-				rd->enqueue( buffPack, No_Trace );
+				if ( !rd->enqueue( buffMsg, No_Trace ) )
+				{
+					LOGW( "Buffered messages on channel %d do not fit in the send window of link %s, remaining messages not sent.", ch, link->info() );
+					break;
+				}
 			}
 		}
 		m_Links.emplace_back( link );
@@ -57,7 +57,7 @@ namespace MiepMiep
 		bool m_Started;
 		MasterSessionData m_MasterData;
 		vector<wptr<Link>> m_Links;
-		vector<sptr<const NormalSendPacket>> m_BufferedPackets[MM_NUM_CHANNELS]; // Pre-fragmented buffered packets.
+		vector<vector<sptr<const NormalSendPacket>>> m_BufferedMessages[MM_NUM_CHANNELS]; // Pre-fragmented buffered messages.
 
 		friend class Link;
 	};
@@ -400,7 +400,9 @@ namespace MiepMiep
 		if ( SOCKET_ERROR == sendto( m_Socket, (const char*)data, len, 0, (const sockaddr*)addr, addrSize ) )
 		{
 		#if MM_PLATFORM_WINDOWS
-			if ( err ) *err = GetLastError();
+			i32 lastErr = GetLastError();
+			if ( err ) *err = lastErr;
+			if ( WSAEMSGSIZE == lastErr ) return ESendResult::MessageTooBig;
 		#endif
 			return ESendResult::Error;
 		}
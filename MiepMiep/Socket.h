@@ -17,7 +17,8 @@ namespace MiepMiep
 	{
 		Succes,
 		Error,
-		SocketClosed
+		SocketClosed,
+		MessageTooBig	// Exceeds the mtu of the local interface, while 'dont fragment' is set.
 	};
 
 	enum class ERecvResult
@@ -0,0 +1,103 @@
+#include "Strand.h"
+
+
+namespace MiepMiep
+{
+	// ------------ Strand --------------------------------------------------------------------------------
+
+	Strand::Strand(JobSystem& js):
+		m_Js(js),
+		m_Head(nullptr),
+		m_Tail(nullptr),
+		m_NumPending(0)
+	{
+	}
+
+	MM_TS void Strand::post( JobFunc&& cb )
+	{
+		Job* j = m_Js.allocJob();
+		j->m_WorkFunc = move( cb );
+		j->m_Next = nullptr;
+		{
+			scoped_spinlock lk( m_QueueLock );
+			if ( m_Tail ) m_Tail->m_Next = j;
+			else m_Head = j;
+			m_Tail = j;
+		}
+		// Only the post that finds the strand idle schedules it.
+		if ( m_NumPending.fetch_add( 1 ) == 0 )
+		{
+			schedule();
+		}
+	}
+
+	MM_TS void Strand::schedule()
+	{
+		#if !MM_MT
+			run();
+			return;
+		#endif
+
+		if ( m_Js.isClosing() )
+		{
+			drop();
+			return;
+		}
+		Job* j = m_Js.allocJob();
+		j->m_WorkFunc = [this]()
+		{
+			run();
+		};
+		j->m_Strand = this;
+		m_Js.push( j );
+		m_Js.wakeOne();
+	}
+
+	MM_TS void Strand::run()
+	{
+		JobSystem& js = m_Js;
+		for ( u32 i=0; i<MM_STRAND_BATCH; ++i )
+		{
+			if ( js.isClosing() )
+			{
+				drop();
+				return;
+			}
+			Job* j;
+			{
+				scoped_spinlock lk( m_QueueLock );
+				j = m_Head;
+				m_Head = j->m_Next;
+				if ( !m_Head ) m_Tail = nullptr;
+			}
+			j->m_WorkFunc();
+			// The callback is destroyed after the strand is released. It may hold the last reference to the owner of the strand.
+			bool last = m_NumPending.fetch_sub( 1 ) == 1;
+			js.freeJob( j );
+			if ( last )
+				return;
+		}
+		// More callbacks are pending, continue in a new job so that other jobs get a turn.
+		schedule();
+	}
+
+	MM_TS void Strand::drop()
+	{
+		// Called instead of run, so this owns the strand until the pending count drops to zero.
+		JobSystem& js = m_Js;
+		while ( true )
+		{
+			Job* j;
+			{
+				scoped_spinlock lk( m_QueueLock );
+				j = m_Head;
+				m_Head = j->m_Next;
+				if ( !m_Head ) m_Tail = nullptr;
+			}
+			bool last = m_NumPending.fetch_sub( 1 ) == 1;
+			js.freeJob( j );
+			if ( last )
+				return;
+		}
+	}
+}
\ No newline at end of file
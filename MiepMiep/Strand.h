@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+#include "Threading.h"
+#include "JobSystem.h"
+
+
+namespace MiepMiep
+{
+	/*
+		Serial executor on top of the JobSystem. Callbacks posted to a strand run in the order they were posted and never
+		concurrently, so the state they touch needs no lock as long as it is only touched from the strand. The strand is in the
+		JobSystem at most once, no matter how many callbacks are posted. It runs a limited batch before it yields to other jobs.
+		Callbacks are queued in job nodes from the JobSystem's pool, so posting does not allocate either.
+		The strand does not keep its owner alive. Posted callbacks must, typically by capturing ptr<T>() of the owner.
+		Once the JobSystem is closing, queued and newly posted callbacks are destroyed without running, releasing the owner.
+	*/
+	class Strand
+	{
+	public:
+		Strand(JobSystem& js);
+
+		MM_TS void post( JobFunc&& cb );
+
+	private:
+		MM_TS void schedule();
+		MM_TS void run();
+		MM_TS void drop();
+
+	private:
+		JobSystem& m_Js;
+		SpinLock m_QueueLock;
+		Job* m_Head;
+		Job* m_Tail;
+		atomic<u32> m_NumPending; // Posted callbacks that did not finish yet. The strand is scheduled while this is non zero.
+
+		friend class JobSystem;
+	};
+}
\ No newline at end of file
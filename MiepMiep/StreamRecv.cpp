@@ -0,0 +1,115 @@
+#include "StreamRecv.h"
+#include "Link.h"
+#include "Network.h"
+#include "SessionBase.h"
+#include "NetworkEvents.h"
+#include "PerThreadDataProvider.h"
+#include "Platform.h"
+
+
+namespace MiepMiep
+{
+	// ------ Event --------------------------------------------------------------------------------
+
+	struct EventStreamData : IEvent
+	{
+		EventStreamData( const sptr<Link>& link, u32 streamId, u64 offset, RecvPacket&& data, bool isLast ):
+			IEvent(link, false),
+			m_StreamId(streamId),
+			m_Offset(offset),
+			m_Data(move(data)),
+			m_IsLast(isLast) { }
+
+		void process() override
+		{
+			if ( !m_Link->getSession() )
+				return;
+			m_Link->getSession()->forListeners( [&] ( ISessionListener* l )
+			{
+				l->onStreamData( m_Link->session(), *m_Link, m_StreamId, m_Offset, m_Data.m_Data, m_Data.m_Length, m_IsLast );
+			});
+		}
+
+		u32 m_StreamId;
+		u64 m_Offset;
+		RecvPacket m_Data;
+		bool m_IsLast;
+	};
+
+
+	// ------ StreamRecv --------------------------------------------------------------------------------
+
+	StreamRecv::StreamRecv(Link& link):
+		ParentLink(link)
+	{
+	}
+
+	StreamRecv::~StreamRecv()
+	{
+		for ( auto& kvp : m_Streams )
+		{
+			if ( kvp.second.m_File ) fclose( kvp.second.m_File );
+		}
+	}
+
+	MM_TS void StreamRecv::setFilePath( u32 streamId, const string& filePath )
+	{
+		scoped_lock lk( m_Mutex );
+		if ( filePath.empty() )
+			m_FilePaths.erase( streamId );
+		else
+			m_FilePaths[streamId] = filePath;
+	}
+
+	MM_TS void StreamRecv::receive( const RecvPacket& pack )
+	{
+		// [ streamId(4) | isLast(1) | data ]
+		auto& bs = PerThreadDataProvider::getSerializer( false );
+		bs.resetTo( pack.m_Data, pack.m_Length, pack.m_Length );
+		u32  streamId;
+		byte isLast;
+		__CHECKED( bs.read( streamId ) );
+		__CHECKED( bs.read( isLast ) );
+		const byte* data = pack.m_Data + bs.getRead();
+		u32 size = pack.m_Length - bs.getRead();
+
+		u64  offset;
+		bool toFile;
+		{
+			scoped_lock lk( m_Mutex );
+			auto sIt = m_Streams.find( streamId );
+			if ( sIt == m_Streams.end() )
+			{
+				Stream stream = { 0, nullptr };
+				auto pIt = m_FilePaths.find( streamId );
+				if ( pIt != m_FilePaths.end() && !(stream.m_File = Platform::fopen( pIt->second.c_str(), "wb" )) )
+				{
+					LOGW( "Cannot open %s for stream %d, the stream is passed to the listeners instead.", pIt->second.c_str(), streamId );
+				}
+				sIt = m_Streams.emplace( streamId, stream ).first;
+			}
+			Stream& stream = sIt->second;
+			offset = stream.m_Offset;
+			toFile = stream.m_File != nullptr;
+			stream.m_Offset += size;
+			if ( toFile && size != 0 && fwrite( data, 1, size, stream.m_File ) != size )
+			{
+				LOGW( "Failed to write stream %d from link %s to file.", streamId, m_Link.info() );
+			}
+			if ( isLast )
+			{
+				if ( toFile ) fclose( stream.m_File );
+				m_Streams.erase( sIt );
+			}
+		}
+
+		if ( !toFile )
+		{
+			m_Link.pushEvent<EventStreamData>( streamId, offset, pack.slice( bs.getRead() ), isLast != 0 );
+		}
+		else if ( isLast )
+		{
+			m_Link.pushEvent<EventStreamData>( streamId, offset, RecvPacket(), true );
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+#include <cstdio>
+#include <map>
+
+
+namespace MiepMiep
+{
+	class Link;
+	struct RecvPacket;
+
+	/*
+		Incoming streams of a link, see INetwork::sendStream. Chunks come in order from the reliable channel.
+		If a file was set for the stream id with INetwork::receiveStreamToFile when the first chunk of a stream arrives, the stream
+		is written to it as it arrives. Otherwise, each chunk is passed to the session listeners. Stream ids must be unique per link.
+	*/
+	class StreamRecv: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		StreamRecv(Link& link);
+		~StreamRecv() override;
+		static EComponentType compType() { return EComponentType::StreamRecv; }
+
+		MM_TS void receive( const RecvPacket& pack );
+		MM_TS void setFilePath( u32 streamId, const string& filePath );
+
+	private:
+		struct Stream
+		{
+			u64   m_Offset;
+			FILE* m_File;
+		};
+
+		mutex m_Mutex;
+		map<u32, Stream> m_Streams;
+		map<u32, string> m_FilePaths;
+	};
+}
\ No newline at end of file
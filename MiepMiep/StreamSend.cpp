@@ -0,0 +1,134 @@
+#include "StreamSend.h"
+#include "Link.h"
+#include "Network.h"
+#include "LinkStats.h"
+#include "ReliableSend.h"
+#include "JobSystem.h"
+#include "Util.h"
+
+
+namespace MiepMiep
+{
+	// ------ StreamSend --------------------------------------------------------------------------------
+
+	StreamSend::StreamSend(Link& link):
+		ParentLink(link)
+	{
+	}
+
+	MM_TS void StreamSend::add( u32 streamId, const StreamReader& reader )
+	{
+		scoped_lock lk( m_Mutex );
+		sptr<Stream> stream = make_shared<Stream>();
+		stream->m_Id	   = streamId;
+		stream->m_Reader   = reader;
+		stream->m_HasChunk = false;
+		stream->m_Reading  = false;
+		stream->m_IsLast   = false;
+		m_Streams.emplace_back( move( stream ) );
+	}
+
+	MM_TS void StreamSend::intervalDispatch( u64 time )
+	{
+		Network& nw  = network();
+		byte channel = (byte)idx();
+		u32 linkHdrSize = MM_RELIABLE_LINK_HDR_SIZE + (nw.channelFec( channel ) != EFecMode::None ? MM_FEC_PARITY_OVERHEAD : 0);
+		u32 chunkSize	= m_Link.getOrAdd<LinkStats>()->mtu() - linkHdrSize - MM_STREAM_CHUNK_HDR_SIZE;
+		auto rs = m_Link.getOrAdd<ReliableSend>( channel );
+
+		// Reads are started after the lock is released, as without worker threads the job runs right away.
+		vector<sptr<Stream>> toRead;
+		{
+			scoped_lock lk( m_Mutex );
+			u32 numWaiting = 0;
+			while ( numWaiting < m_Streams.size() && rs->numQueued() < MM_STREAM_WINDOW )
+			{
+				sptr<Stream> stream = move( m_Streams.front() );
+				m_Streams.pop_front();
+				if ( !stream->m_HasChunk )
+				{
+					// A stream of which even the last chunk could not be written is dropped.
+					if ( stream->m_IsLast && !stream->m_Reading )
+						continue;
+					if ( !stream->m_Reading )
+					{
+						stream->m_Reading = true;
+						toRead.emplace_back( stream );
+					}
+					m_Streams.emplace_back( move( stream ) );
+					numWaiting++;
+					continue;
+				}
+				numWaiting = 0;
+
+				const BinSerializer* bs[] = { &stream->m_Chunk };
+				ESendCallResult res = nw.sendReliable( (byte)EPacketType::Stream, nullptr, &m_Link, bs, 1, No_Buffer, No_Relay, false, channel, nullptr );
+				if ( res == ESendCallResult::WouldBlock )
+				{
+					// Try again next interval, the chunk is kept.
+					m_Streams.emplace_front( move( stream ) );
+					break;
+				}
+				stream->m_HasChunk = false;
+				if ( res != ESendCallResult::Fine )
+				{
+					LOGW( "Stream %d to link %s stopped, the send failed.", stream->m_Id, m_Link.info() );
+					if ( stream->m_IsLast )
+						continue;
+					// Try once to end the stream on the remote.
+					stream->m_IsLast   = true;
+					stream->m_HasChunk = writeChunk( stream->m_Chunk, stream->m_Id, nullptr, 0, true );
+				}
+				if ( stream->m_IsLast && !stream->m_HasChunk )
+					continue;
+				if ( !stream->m_HasChunk )
+				{
+					stream->m_Reading = true;
+					toRead.emplace_back( stream );
+				}
+				// Next stream's turn.
+				m_Streams.emplace_back( move( stream ) );
+			}
+		}
+
+		if ( toRead.empty() )
+			return;
+		auto js = m_Link.getInNetwork<JobSystem>();
+		for ( auto& stream : toRead )
+		{
+			js->addJob( [ss = ptr<StreamSend>(), stream, chunkSize]()
+			{
+				ss->readChunk( stream, chunkSize );
+			});
+		}
+	}
+
+	MM_TS void StreamSend::readChunk( const sptr<Stream>& stream, u32 chunkSize )
+	{
+		// The reader and chunk of a stream are only touched by the one read job in flight.
+		thread_local static vector<byte> readBuffer;
+		readBuffer.resize( chunkSize );
+		u32  size	= Util::min( stream->m_Reader( readBuffer.data(), chunkSize ), chunkSize );
+		bool isLast = size == 0;
+		bool ok		= writeChunk( stream->m_Chunk, stream->m_Id, readBuffer.data(), size, isLast );
+		if ( !ok )
+		{
+			LOGW( "Stream %d to link %s stopped, the chunk could not be written.", stream->m_Id, m_Link.info() );
+			isLast = true;
+			ok = writeChunk( stream->m_Chunk, stream->m_Id, nullptr, 0, true );
+		}
+		scoped_lock lk( m_Mutex );
+		stream->m_IsLast   = isLast;
+		stream->m_HasChunk = ok;
+		stream->m_Reading  = false;
+	}
+
+	bool StreamSend::writeChunk( BinSerializer& bs, u32 streamId, const byte* data, u32 size, bool isLast )
+	{
+		bs.reset();
+		__CHECKEDB( bs.write( streamId ) );
+		__CHECKEDB( bs.write( (byte)(isLast ? 1 : 0) ) );
+		__CHECKEDB( bs.write( data, size ) );
+		return true;
+	}
+}
\ No newline at end of file
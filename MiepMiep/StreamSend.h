@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Memory.h"
+#include "Component.h"
+#include "ParentLink.h"
+#include "BinSerializer.h"
+#include "MiepMiep.h"
+#include <deque>
+
+
+namespace MiepMiep
+{
+	class Link;
+
+	/*
+		Streams of a channel, see INetwork::sendStream. Each interval, chunks are queued as reliable messages until the channel
+		has MM_STREAM_WINDOW packets unacked, so only that much of a stream is in memory. Streams on the same channel take turns per chunk.
+		The reader runs in a job one chunk ahead of the send, so a slow reader delays only its own stream and not the send thread.
+		A chunk is [ streamId(4) | isLast(1) | data ] and fills a single packet of the current path mtu. A stream that fails
+		ends with an empty last chunk, so that the remote releases it.
+	*/
+	class StreamSend: public ParentLink, public IComponent, public ITraceable
+	{
+	public:
+		StreamSend(Link& link);
+		static EComponentType compType() { return EComponentType::StreamSend; }
+
+		MM_TS void add( u32 streamId, const StreamReader& reader );
+		MM_TS void intervalDispatch( u64 time );
+
+	private:
+		struct Stream
+		{
+			u32 m_Id;
+			StreamReader m_Reader;
+			BinSerializer m_Chunk; // Read but not yet queued. Only written by the read job while 'm_Reading'.
+			bool m_HasChunk;
+			bool m_Reading;
+			bool m_IsLast;		   // The chunk ends the stream.
+		};
+
+		// Runs in a job, calls the reader without holding the lock.
+		MM_TS void readChunk( const sptr<Stream>& stream, u32 chunkSize );
+		static bool writeChunk( BinSerializer& bs, u32 streamId, const byte* data, u32 size, bool isLast );
+
+	private:
+		mutex m_Mutex;
+		deque<sptr<Stream>> m_Streams;
+	};
+}
\ No newline at end of file
@@ -41,12 +41,14 @@ namespace MiepMiep
 	class BinSerializer;
 	class IDeliveryTrace;
 	class ISessionListener;
+	struct RpcHeader;
 
 	enum class EPacketType : byte;
 	enum class EConnectResult : byte;
 	enum class EDisconnectReason : byte;
 	enum class ERegisterServerResult : byte;
 	enum class EJoinServerResult : byte;
+	enum class EFecMode : byte;
 
 	enum class EVarControl;
 	enum class ESendResult;
@@ -58,6 +60,7 @@ namespace MiepMiep
 
 	template <typename T>
 	using sptr		= std::shared_ptr<T>;
+	using RpcFunc	= void (*)( INetwork&, const ILink&, BinSerializer&, byte );
 	using MetaData	= std::map<std::string, std::string>;
 
 
@@ -81,7 +84,16 @@ namespace MiepMiep
 
 	// ---- !! FOR INTERNAL USE ONLY !! ------
 	MM_TS MM_DECLSPEC extern BinSerializer& priv_get_thread_serializer();
-	MM_TS MM_DECLSPEC extern ESendCallResult priv_send_rpc(INetwork& nw, const char* rpcName, BinSerializer& bs, const ISession* session, ILink* exclOrSpecific, bool buffer, bool relay, bool sysBit, byte channel, IDeliveryTrace* trace); 
+	MM_TS MM_DECLSPEC extern ESendCallResult priv_send_rpc(INetwork& nw, const RpcHeader* rpc, BinSerializer& bs, const ISession* session, ILink* exclOrSpecific, bool buffer, bool relay, bool sysBit, byte channel, IDeliveryTrace* trace); 
+	MM_TS MM_DECLSPEC extern ESendCallResult priv_send_rpc_unreliable(INetwork& nw, const RpcHeader* rpc, BinSerializer& bs, const ISession* session, ILink* exclOrSpecific, bool relay, bool sysBit, byte channel);
 	MM_TS MM_DECLSPEC extern ECreateGroupCallResult priv_create_group(INetwork& nw, const ISession& session, const char* groupType, BinSerializer& bs, byte channel, IDeliveryTrace* trace);
-	MM_TS MM_DECLSPEC extern void* priv_get_rpc_func(const std::string& name);
+	MM_TS MM_DECLSPEC extern u32 priv_register_rpc(u32 hash, const char* name, RpcFunc func);
+	MM_TS MM_DECLSPEC extern RpcFunc priv_get_rpc_func(u32 hash);
+	MM_TS MM_DECLSPEC extern const RpcHeader* priv_get_rpc_header(u32 hash);
+
+	// FNV-1a, evaluated at compile time for rpc names. Masked as u32 is 64 bits on some platforms.
+	constexpr u32 priv_hash_name(const char* name, u32 hash=2166136261U)
+	{
+		return *name ? priv_hash_name( name+1, ((hash ^ (byte)*name) * 16777619U) & 0xFFFFFFFFU ) : hash;
+	}
 }
\ No newline at end of file
@@ -1,18 +1,35 @@
 #include "UnreliableRecv.h"
+#include "Link.h"
+#include "LinkStats.h"
+#include "PacketHelper.h"
 
 
 namespace MiepMiep
 {
-
 	UnreliableRecv::UnreliableRecv(Link& link):
-		ParentLink(link)
+		ParentLink(link),
+		m_HasReceived(false),
+		m_NewestSequence(0)
 	{
-
 	}
 
-	void UnreliableRecv::receive(class BinSerializer& bs)
+	MM_TS void UnreliableRecv::receive( BinSerializer& bs, const PacketInfo& pi )
 	{
+		{
+			scoped_spinlock lk( m_SeqMutex );
+			if ( m_HasReceived && (pi.m_Sequence == m_NewestSequence || !PacketHelper::isSeqNewer( pi.m_Sequence, m_NewestSequence )) )
+			{
+				m_Link.getOrAdd<LinkStats>()->addStaleDrop();
+				return;
+			}
+			m_HasReceived = true;
+			m_NewestSequence = pi.m_Sequence;
+		}
 
+		byte packId;
+		__CHECKED( bs.read( packId ) );
+		// Views the receive buffer, handlers that keep the payload copy it.
+		RecvPacket pack( packId, bs.data()+bs.getRead(), bs.getWrite()-bs.getRead(), pi.m_ChannelAndFlags, false );
+		m_Link.handlePacket( pack );
 	}
-
 }
\ No newline at end of file
@@ -3,18 +3,28 @@
 #include "Memory.h"
 #include "Component.h"
 #include "ParentLink.h"
+#include "Threading.h"
 
 
 namespace MiepMiep
 {
 	class Link;
 
+	/*
+		Receives unreliable sequenced packets of a single channel. A packet that is not newer than the newest
+		packet received so far is stale and dropped. Accepted packets are handled immediately.
+	*/
 	class UnreliableRecv: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		UnreliableRecv(Link& link);
 		static EComponentType compType() { return EComponentType::UnreliableRecv; }
 
-		void receive( class BinSerializer& bs );
+		MM_TS void receive( class BinSerializer& bs, const struct PacketInfo& pi );
+
+	private:
+		SpinLock m_SeqMutex;
+		bool m_HasReceived;
+		u32  m_NewestSequence;
 	};
-}
+}
\ No newline at end of file
@@ -1,12 +1,72 @@
 #include "UnreliableSend.h"
+#include "Network.h"
+#include "Link.h"
+#include "PacketHelper.h"
+#include "RpcRegistry.h"
+#include "Util.h"
+
 
 namespace MiepMiep
 {
-
 	UnreliableSend::UnreliableSend(Link& link):
-		ParentLink(link)
+		ParentLink(link),
+		m_Sequence(0)
 	{
+	}
 
+	MM_TS void UnreliableSend::enqueue( const sptr<const NormalSendPacket>& packet )
+	{
+		scoped_lock lk( m_QueueMutex );
+		assert( packet->m_PayLoad.length() + MM_UNRELIABLE_LINK_HDR_SIZE <= MM_MAX_PLPMTU );
+		if ( m_Queue.size() >= MM_MAX_UNRELIABLE_QUEUE )
+		{
+			m_Queue.pop_front();
+		}
+		m_Queue.emplace_back( packet );
+	}
+
+	MM_TS u32 UnreliableSend::nextSendSize()
+	{
+		scoped_lock lk( m_QueueMutex );
+		if ( m_Queue.empty() )
+			return 0;
+		return m_Queue.front()->m_PayLoad.length() + MM_UNRELIABLE_LINK_HDR_SIZE;
 	}
 
+	MM_TS u32 UnreliableSend::sendNext()
+	{
+		sptr<const NormalSendPacket> packet;
+		u32 seq;
+		{
+			scoped_lock lk( m_QueueMutex );
+			if ( m_Queue.empty() )
+				return 0;
+			packet = move( m_Queue.front() );
+			m_Queue.pop_front();
+			seq = m_Sequence++;
+		}
+
+		// The sequence is specific to each link, all other data in the packet is shared by all links.
+		// [ seq(4) | compType(1) | channelAndFlags(1) | dataId(1) | data ]
+		const byte* payLoad = packet->m_PayLoad.data();
+		u32 payLoadLen = packet->m_PayLoad.length();
+		byte finalData[MM_MAX_SENDSIZE];
+		*(u32*)(finalData) = Util::htonl( seq );
+		Platform::memCpy( finalData + MM_UNRELIABLE_LINK_HDR_SIZE, MM_MAX_SENDSIZE-MM_UNRELIABLE_LINK_HDR_SIZE, payLoad, payLoadLen );
+		m_Link.send( finalData, payLoadLen + MM_UNRELIABLE_LINK_HDR_SIZE );
+		return payLoadLen + MM_UNRELIABLE_LINK_HDR_SIZE;
+	}
+
+	// Placed here because unreliable RPC is always an unreliable sequenced send.
+	MM_TS ESendCallResult priv_send_rpc_unreliable(INetwork& nw, const RpcHeader* rpc, BinSerializer& payLoad, const ISession* session, ILink* exclOrSpecific,
+												   bool relay, bool sysBit, byte channel)
+	{
+		if ( !rpc )
+		{
+			LOGC( "Rpc was not registered or its name hash collides with another rpc, see log at startup." );
+			return ESendCallResult::InternalError;
+		}
+		const BinSerializer* binSerializers [] = { &rpc->m_Unnamed, &payLoad };
+		return toNetwork( nw ).sendUnreliable( (byte)EPacketType::RPC, session, sc<Link*>( exclOrSpecific ), binSerializers, 2, relay, sysBit, channel, rpc );
+	}
 }
\ No newline at end of file
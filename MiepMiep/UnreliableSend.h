@@ -3,17 +3,35 @@
 #include "Memory.h"
 #include "Component.h"
 #include "ParentLink.h"
+#include <deque>
 
 
 namespace MiepMiep
 {
 	class Link;
+	struct NormalSendPacket;
 
-
+	/*
+		Unreliable sequenced packets of a single channel. Packets are never resent and never fragmented.
+		They wait in a small queue until the SendScheduler pulls them. If the queue is full, the oldest packet is dropped
+		as newer state makes it stale anyway.
+	*/
 	class UnreliableSend: public ParentLink, public IComponent, public ITraceable
 	{
 	public:
 		UnreliableSend(Link& link);
 		static EComponentType compType() { return EComponentType::UnreliableSend; }
+
+		MM_TS void enqueue( const sptr<const NormalSendPacket>& packet );
+
+		// Called by the SendScheduler. Size in bytes on the wire of the next packet to send, 0 if there is nothing to send.
+		MM_TS u32 nextSendSize();
+		// Sends the next packet and returns its size on the wire, 0 if nothing was sent.
+		MM_TS u32 sendNext();
+
+	private:
+		mutex m_QueueMutex;
+		u32 m_Sequence;
+		deque<sptr<const NormalSendPacket>> m_Queue;
 	};
-}
+}
\ No newline at end of file
@@ -42,6 +42,11 @@ namespace MiepMiep
 		return duration_cast<milliseconds>(high_resolution_clock::now().time_since_epoch()).count();
 	}
 
+	u64 Util::abs_time_us()
+	{
+		return duration_cast<microseconds>(high_resolution_clock::now().time_since_epoch()).count();
+	}
+
 	u32 Util::rand()
 	{
 		static SpinLock sl;
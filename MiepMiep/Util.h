@@ -25,6 +25,7 @@ namespace MiepMiep
 		static void cluster( S s, u32 clusterSize, const Pred& pred );
 
 		static u64 abs_time();
+		static u64 abs_time_us();
 		static u32 rand();
 	};
 
@@ -4,6 +4,7 @@
 #include "Socket.h"
 #include "Memory.h"
 #include "BinSerializer.h"
+#include "BitSerializer.h"
 #include "Threading.h"
 #include "PerThreadDataProvider.h"
 #include "Util.h"
@@ -13,6 +14,13 @@
 #include "MasterSessionManager.h"
 #include "SocketSetManager.h"
 #include "Common.h"
+#include "SequenceBuffer.h"
+#include "JobSystem.h"
+#include "Strand.h"
+#include "Link.h"
+#include "ReliableNewRecv.h"
+#include "Lz.h"
+#include "Fec.h"
 #include <thread>
 #include <mutex>
 #include <cassert>
@@ -471,4 +479,481 @@ UTESTBEGIN( SapLookupInMap )
 
 	return true;
 }
-UNITTESTEND( SapLookupInMap )
\ No newline at end of file
+UNITTESTEND( SapLookupInMap )
+
+
+UTESTBEGIN( SequenceBufferTest )
+{
+	// Start just before the wrap around of the sequence number.
+	u32 start = UINT_MAX - 100;
+	SequenceBuffer<u32> sb( 64, 1024, start );
+	for ( u32 i=0; i<300; i++ )
+	{
+		u32* v = sb.insert( start + i );
+		if ( !v ) return false;
+		*v = i;
+	}
+	if ( sb.count() != 300 || sb.capacity() != 512 ) return false;
+	if ( sb.insert( start + 5 ) ) return false; // duplicate
+	if ( sb.insert( start + 1024 ) ) return false; // exceeds max capacity
+
+	// Remove out of order, begin only moves past a contiguous removed range.
+	sb.remove( start + 1 );
+	sb.advanceBegin();
+	if ( sb.beginSeq() != start ) return false;
+	sb.remove( start );
+	sb.advanceBegin();
+	if ( sb.beginSeq() != start + 2 || sb.count() != 298 ) return false;
+	for ( u32 i=2; i<300; i++ )
+	{
+		u32* v = sb.get( start + i );
+		if ( !v || *v != i ) return false;
+	}
+	if ( sb.get( start ) || sb.get( start + 300 ) ) return false;
+
+	// Pop front moves begin even if there is no entry.
+	while ( !sb.empty() ) sb.popFront();
+	if ( sb.beginSeq() != start + 300 ) return false;
+	sb.popFront();
+	if ( sb.beginSeq() != start + 301 || sb.endSeq() != start + 301 ) return false;
+	return true;
+}
+UNITTESTEND( SequenceBufferTest )
+
+
+UTESTBEGIN( VarIntTest )
+{
+	// Round trip edge values, including the fast paths with more than 8 bytes left in the buffer.
+	BinSerializer bs;
+	bs.setIntEncoding( EIntEncoding::Varint );
+	const u64 u64s[] = { 0, 1, 127, 128, 16383, 16384, UINT_MAX, ~0ULL };
+	const i64 i64s[] = { 0, -1, 1, -64, 64, LLONG_MIN, LLONG_MAX };
+	for ( auto v : u64s ) { __CHECKEDB( bs.write( v ) ); __CHECKEDB( bs.write( (u32)v ) ); }
+	for ( auto v : i64s ) { __CHECKEDB( bs.write( v ) ); __CHECKEDB( bs.write( (i32)v ) ); __CHECKEDB( bs.write( (i16)v ) ); }
+	for ( auto v : u64s )
+	{
+		u64 a; u32 b;
+		if ( !bs.read( a ) || a != v || !bs.read( b ) || b != (u32)v ) return false;
+	}
+	for ( auto v : i64s )
+	{
+		i64 a; i32 b; i16 c;
+		if ( !bs.read( a ) || a != v || !bs.read( b ) || b != (i32)v || !bs.read( c ) || c != (i16)v ) return false;
+	}
+
+	// A value that does not fit the type it is read as must fail.
+	BinSerializer bs2;
+	bs2.writeVarint( (u64)1<<40 );
+	u32 tooBig;
+	if ( bs2.readVarint( tooBig ) ) return false;
+
+	// Bits beyond the width of the type in the final byte and overlong encodings must fail, both in the byte
+	// loop and, with 8 or more bytes left, in the fast path.
+	const byte maxU64[]   = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+	const byte overU64[]  = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F };
+	const byte overU32[]  = { 0xFF, 0xFF, 0xFF, 0xFF, 0x1F, 0, 0, 0 };
+	const byte overlong[] = { 0x81, 0x80, 0x00, 0, 0, 0, 0, 0 };
+	BinSerializer bs3;
+	u64 big;
+	bs3.resetTo( maxU64, sizeof(maxU64), sizeof(maxU64) );
+	if ( !bs3.readVarint( big ) || big != ~0ULL ) return false;
+	bs3.resetTo( overU64, sizeof(overU64), sizeof(overU64) );
+	if ( bs3.readVarint( big ) ) return false;
+	bs3.resetTo( overU32, sizeof(overU32), sizeof(overU32) );
+	if ( bs3.readVarint( tooBig ) ) return false;
+	bs3.resetTo( overU32, 5, 5 );
+	if ( bs3.readVarint( tooBig ) ) return false;
+	bs3.resetTo( overlong, sizeof(overlong), sizeof(overlong) );
+	if ( bs3.readVarint( big ) ) return false;
+	bs3.resetTo( overlong, 3, 3 );
+	if ( bs3.readVarint( big ) ) return false;
+
+	// Bytes saved on typical rpc arguments: ids, counters, small deltas.
+	BinSerializer fixed, var;
+	var.setIntEncoding( EIntEncoding::Varint );
+	for ( u32 i=0; i<1000; i++ )
+	{
+		u32 groupId = i;
+		i32 delta   = (i32)(rand() % 200) - 100;
+		u16 count   = (u16)(rand() % 50);
+		fixed.write( groupId ); fixed.write( delta ); fixed.write( count );
+		var.write( groupId ); var.write( delta ); var.write( count );
+	}
+	cout << "VarInt: " << fixed.length() << " bytes fixed, " << var.length() << " bytes varint" << endl;
+	return var.length() < fixed.length() / 2;
+}
+UNITTESTEND( VarIntTest )
+
+
+UTESTBEGIN( BitSerializerTest )
+{
+	Transform t = { { 100.25f, -3.5f, 511.f }, { 0.f, 0.70710678f, 0.f, -0.70710678f } };
+	BinSerializer bs;
+	BitSerializer w( bs, true );
+	__CHECKEDB( w.writeBits( 5, 3 ) );
+	__CHECKEDB( w.writeInt( -7, -10, 10 ) );
+	__CHECKEDB( w.flush() );
+	u32 headerLen = bs.length();
+	__CHECKEDB( (TransformPrecision<-512, 512, 14, 9>::readOrWrite( w, t )) );
+	__CHECKEDB( w.flush() );
+	if ( bs.length() - headerLen > 9 ) return false;
+
+	BitSerializer r( bs, false );
+	u32 bits; i32 i;
+	Transform t2;
+	if ( !r.readBits( bits, 3 ) || bits != 5 || !r.readInt( i, -10, 10 ) || i != -7 ) return false;
+	__CHECKEDB( r.flush() );
+	__CHECKEDB( (TransformPrecision<-512, 512, 14, 9>::readOrWrite( r, t2 )) );
+	if ( fabsf( t2.m_Position.x - t.m_Position.x ) > 0.1f || fabsf( t2.m_Position.z - t.m_Position.z ) > 0.1f ) return false;
+	// Same rotation, possibly negated.
+	float dot = t.m_Rotation.x*t2.m_Rotation.x + t.m_Rotation.y*t2.m_Rotation.y + t.m_Rotation.z*t2.m_Rotation.z + t.m_Rotation.w*t2.m_Rotation.w;
+	return fabsf( dot ) > 0.999f;
+}
+UNITTESTEND( BitSerializerTest )
+
+
+namespace MiepMiep
+{
+	// Trivially copyable, but quantized to a byte by its own read/write, so it opts out of the bulk copy.
+	struct Health { float m_Value; };
+	template <> struct IsBulkCopyable<Health>: std::false_type { };
+
+	template <>
+	inline bool readOrWrite( BinSerializer& bs, Health& h, bool _write )
+	{
+		byte b = (byte)(h.m_Value * 255.f + .5f);
+		if ( !bs.readOrWrite( b, _write ) ) return false;
+		if ( !_write ) h.m_Value = b / 255.f;
+		return true;
+	}
+
+	// Not trivially copyable, only serializable through its own read/write.
+	struct NamedId { u16 m_Id; string m_Name; };
+
+	template <>
+	inline bool readOrWrite( BinSerializer& bs, NamedId& n, bool _write )
+	{
+		if ( !bs.readOrWrite( n.m_Id, _write ) ) return false;
+		if ( !bs.readOrWrite( n.m_Name, _write ) ) return false;
+		return true;
+	}
+}
+
+UTESTBEGIN( BulkSerializeTest )
+{
+	struct Particle { float x, y; u16 color; };
+	vector<u32> ids( 1000 );
+	for ( u32 i=0; i<ids.size(); i++ ) ids[i] = i*7919;
+	array<Particle, 3> particles = { { { 1.f, 2.f, 3 }, { 4.f, 5.f, 6 }, { 7.f, 8.f, 9 } } };
+	vector<string> names = { "a", "bb", "ccc" };
+
+	BinSerializer bs;
+	__CHECKEDB( bs.write( ids ) );
+	__CHECKEDB( bs.write( particles ) );
+	__CHECKEDB( bs.write( names ) );
+
+	// Bulk copied scalars must match the element wise network order.
+	BinSerializer single;
+	single.write( ids[1] );
+	if ( memcmp( single.data(), bs.data() + 2 + 4, 4 ) != 0 ) return false;
+
+	vector<u32> ids2;
+	array<Particle, 3> particles2;
+	vector<string> names2;
+	__CHECKEDB( bs.read( ids2 ) );
+	__CHECKEDB( bs.read( particles2 ) );
+	__CHECKEDB( bs.read( names2 ) );
+	if ( ids2 != ids || names2 != names ) return false;
+	if ( memcmp( particles.data(), particles2.data(), sizeof(particles) ) != 0 ) return false;
+
+	// Varint encoded integers are written per element.
+	BinSerializer var;
+	var.setIntEncoding( EIntEncoding::Varint );
+	__CHECKEDB( var.write( ids ) );
+	ids2.clear();
+	__CHECKEDB( var.read( ids2 ) );
+	if ( ids2 != ids || var.length() >= bs.length() ) return false;
+
+	// Elements with their own read/write go through it, also in arrays.
+	vector<Health> health = { { 0.f }, { .5f }, { 1.f } };
+	array<NamedId, 2> named = { { { 1, "one" }, { 2, "two" } } };
+	BinSerializer custom;
+	__CHECKEDB( custom.write( health ) );
+	if ( custom.length() != 1 + 3 ) return false;
+	__CHECKEDB( custom.write( named ) );
+	vector<Health> health2;
+	array<NamedId, 2> named2;
+	__CHECKEDB( custom.read( health2 ) );
+	__CHECKEDB( custom.read( named2 ) );
+	if ( health2.size() != 3 || fabsf( health2[1].m_Value - .5f ) > 0.01f || health2[2].m_Value != 1.f ) return false;
+	return named2[0].m_Id == 1 && named2[0].m_Name == "one" && named2[1].m_Id == 2 && named2[1].m_Name == "two";
+}
+UNITTESTEND( BulkSerializeTest )
+
+
+UTESTBEGIN( JobPoolTest )
+{
+	sptr<INetwork> nw = INetwork::create();
+	sptr<JobSystem> js = toNetwork( *nw ).get<JobSystem>();
+	auto strand = make_shared<Strand>( *js );
+	atomic<u32> numDone( 0 );
+	atomic<bool> go( true );
+	u32 order = 0;
+	u32 seq = 0;
+	bool ordered = true;
+
+	// Half of the jobs go through the strand, which must run them in order.
+	auto runBatch = [&] ( u32 num )
+	{
+		u32 target = numDone + num*2;
+		for ( u32 i=0; i<num; i++ )
+		{
+			js->addJob( [&numDone, &go]() { while ( !go ) this_thread::yield(); numDone++; } );
+			strand->post( [&order, &ordered, &numDone, idx = seq++]() { ordered &= (order++ == idx); numDone++; } );
+		}
+		go = true;
+		while ( numDone < target ) this_thread::yield();
+	};
+
+	// Warm up the pool with all jobs in flight at once, twice so that the workers' free lists are filled as well.
+	for ( u32 i=0; i<2; i++ )
+	{
+		go = false;
+		runBatch( 1000 );
+	}
+	u64 numAllocs = js->numHeapAllocations();
+	for ( u32 i=0; i<20; i++ )
+	{
+		runBatch( 1000 );
+	}
+	return ordered && js->numHeapAllocations() == numAllocs;
+}
+UNITTESTEND( JobPoolTest )
+
+
+UTESTBEGIN( ReliableNewDuplicateTest )
+{
+	sptr<INetwork> nw = INetwork::create( false );
+	sptr<ISocket> sock = ISocket::create();
+	if ( !sock->open() ) return false;
+	if ( !sock->bind( 0 ) ) return false;
+	sptr<IAddress> addr = IAddress::resolve( "localhost", 23002 );
+	if ( !addr ) return false;
+	sptr<Link> link = Link::create( toNetwork( *nw ), nullptr, SocketAddrPair( sock, addr ) );
+	if ( !link ) return false;
+	sptr<ReliableNewRecv> rnr = link->getOrAdd<ReliableNewRecv>();
+
+	// The same packet twice, the retransmit must not be handled again.
+	if ( !rnr->acceptVersion( 7, 100 ) ) return false;
+	if ( rnr->acceptVersion( 7, 100 ) ) return false;
+
+	// Older versions are dropped, newer ones accepted. Keys are independent.
+	if ( rnr->acceptVersion( 7, 99 ) ) return false;
+	if ( !rnr->acceptVersion( 7, 101 ) ) return false;
+	if ( rnr->acceptVersion( 7, 101 ) ) return false;
+	if ( !rnr->acceptVersion( 8, 100 ) ) return false;
+
+	return true;
+}
+UNITTESTEND( ReliableNewDuplicateTest )
+
+
+UTESTBEGIN( LzTest )
+{
+	const char* dictText = "playerName position rotation velocity health spawnPlayer updatePosition";
+	LzDictionary dict( (const byte*)dictText, (u32)strlen( dictText ) );
+
+	string text;
+	for ( u32 i=0; i<20; ++i ) text += "updatePosition position " + to_string( i ) + " velocity ";
+	vector<byte> message( text.begin(), text.end() );
+	vector<byte> small( (const byte*)"spawnPlayer playerName health", (const byte*)"spawnPlayer playerName health" + 29 );
+	vector<byte> random( 1000 );
+	for ( auto& b : random ) b = (byte)(rand() & 255);
+	vector<byte> empty;
+
+	// Decompresses into a buffer with guard bytes behind it, which must stay untouched.
+	bool inBounds = true;
+	auto decompress = [&] ( const vector<byte>& comp, const LzDictionary* d, u32 dstLen, vector<byte>& out ) -> bool
+	{
+		out.assign( dstLen + 16, 0xCD );
+		bool ok = Lz::decompress( comp.data(), (u32)comp.size(), d, out.data(), dstLen );
+		for ( u32 i=dstLen; i<out.size(); ++i ) inBounds &= out[i] == 0xCD;
+		out.resize( dstLen );
+		return ok;
+	};
+
+	auto compress = [] ( const vector<byte>& src, const LzDictionary* d ) -> vector<byte>
+	{
+		// Worst case is all literals.
+		vector<byte> comp( src.size() + src.size()/255 + 16 );
+		u32 len = Lz::compress( src.data(), (u32)src.size(), d, comp.data(), (u32)comp.size() );
+		comp.resize( len );
+		return comp;
+	};
+
+	vector<byte> out;
+	const LzDictionary* dicts[] = { nullptr, &dict };
+	const vector<byte>* sources[] = { &message, &small, &random, &empty };
+	for ( auto* d : dicts )
+	{
+		for ( auto* src : sources )
+		{
+			vector<byte> comp = compress( *src, d );
+			if ( comp.empty() ) return false;
+			if ( Lz::originalSize( comp.data(), (u32)comp.size() ) != src->size() ) return false;
+			if ( !decompress( comp, d, (u32)src->size(), out ) ) return false;
+			if ( out != *src ) return false;
+		}
+	}
+
+	// Repetitive data shrinks, the dictionary helps small messages.
+	if ( compress( message, nullptr ).size() >= message.size() / 2 ) return false;
+	if ( compress( small, &dict ).size() >= compress( small, nullptr ).size() ) return false;
+
+	// Incompressible data does not fit in a buffer of its own size.
+	vector<byte> tooSmall( random.size() );
+	if ( Lz::compress( random.data(), (u32)random.size(), nullptr, tooSmall.data(), (u32)tooSmall.size() ) != 0 ) return false;
+
+	// Every truncation fails. The copy is exactly sized, so that a read past the end is caught by a checked heap.
+	vector<byte> comp = compress( message, &dict );
+	for ( u32 len=0; len<comp.size(); ++len )
+	{
+		vector<byte> truncated( comp.begin(), comp.begin() + len );
+		if ( decompress( truncated, &dict, (u32)message.size(), out ) ) return false;
+	}
+
+	// Without the dictionary its references cannot be resolved.
+	if ( decompress( compress( small, &dict ), nullptr, (u32)small.size(), out ) ) return false;
+
+	// Corrupted data may decode to garbage but must stay within bounds.
+	for ( u32 i=0; i<comp.size(); ++i )
+	{
+		vector<byte> corrupt = comp;
+		corrupt[i] ^= (byte)(1 + rand() % 255);
+		decompress( corrupt, &dict, (u32)message.size(), out );
+	}
+	for ( u32 i=0; i<1000; ++i )
+	{
+		vector<byte> garbage( 5 + rand() % 64 );
+		for ( auto& b : garbage ) b = (byte)(rand() & 255);
+		u32 dstLen = rand() % 128;
+		garbage[0] = garbage[1] = garbage[2] = 0;
+		garbage[3] = (byte)dstLen;
+		decompress( garbage, &dict, dstLen, out );
+	}
+
+	return inBounds;
+}
+UNITTESTEND( LzTest )
+
+
+UTESTBEGIN( FecTest )
+{
+	const u32 length = 100;
+
+	// Encodes a group, drops the given sources and parity symbols and tries to recover the sources byte for byte.
+	auto recover = [&] ( EFecMode mode, u32 k, u32 m, const vector<u32>& lostSources, const vector<u32>& lostParity ) -> bool
+	{
+		vector<vector<byte>> sources( k, vector<byte>( length ) );
+		vector<vector<byte>> parity( m, vector<byte>( length ) );
+		for ( auto& s : sources ) for ( auto& b : s ) b = (byte)(rand() & 255);
+		vector<const byte*> srcPtrs;
+		vector<byte*> parPtrs;
+		for ( auto& s : sources ) srcPtrs.emplace_back( s.data() );
+		for ( auto& p : parity ) parPtrs.emplace_back( p.data() );
+		Fec::encode( mode, srcPtrs.data(), k, parPtrs.data(), m, length );
+
+		vector<vector<byte>> received = sources;
+		bool present[256];
+		for ( u32 i=0; i<k; ++i ) present[i] = true;
+		for ( u32 i : lostSources )
+		{
+			present[i] = false;
+			for ( auto& b : received[i] ) b = (byte)(rand() & 255);
+		}
+		vector<byte*> recvPtrs;
+		vector<const byte*> recvParity;
+		for ( auto& s : received ) recvPtrs.emplace_back( s.data() );
+		for ( auto& p : parity ) recvParity.emplace_back( p.data() );
+		for ( u32 j : lostParity ) recvParity[j] = nullptr;
+
+		if ( !Fec::decode( mode, recvPtrs.data(), present, k, recvParity.data(), m, length ) )
+			return false;
+		return received == sources;
+	};
+
+	// Reed-Solomon recovers up to as many lost sources as there are parity symbols left, whichever ones are lost.
+	const u32 k = MM_FEC_RS_GROUP;
+	const u32 m = 4;
+	for ( u32 numLost=1; numLost<=m; ++numLost )
+	{
+		for ( u32 round=0; round<20; ++round )
+		{
+			vector<u32> all;
+			for ( u32 i=0; i<k; ++i ) all.emplace_back( i );
+			for ( u32 i=k-1; i>0; --i ) swap( all[i], all[rand() % (i+1)] );
+			vector<u32> lost( all.begin(), all.begin() + numLost );
+			// Also lose the parity symbols that are not needed, so that every parity row gets used.
+			vector<u32> lostParity;
+			for ( u32 j=0; j<m-numLost; ++j ) lostParity.emplace_back( (round + j) % m );
+			if ( !recover( EFecMode::ReedSolomon, k, m, lost, lostParity ) ) return false;
+		}
+	}
+	if ( !recover( EFecMode::ReedSolomon, k, m, {}, {} ) ) return false;
+	if ( !recover( EFecMode::ReedSolomon, k, m, { 0, k-1 }, { 0 } ) ) return false;
+	if ( recover( EFecMode::ReedSolomon, k, m, { 0, 1, 2, 3, 4 }, {} ) ) return false;
+	if ( recover( EFecMode::ReedSolomon, k, m, { 0, 1, 2 }, { 1, 3 } ) ) return false;
+
+	// Xor recovers a single loss anywhere in the group, but not two.
+	for ( u32 i=0; i<8; ++i )
+	{
+		if ( !recover( EFecMode::Xor, 8, 1, { i }, {} ) ) return false;
+	}
+	if ( recover( EFecMode::Xor, 8, 1, { 2, 5 }, {} ) ) return false;
+	if ( recover( EFecMode::Xor, 8, 1, { 2 }, { 0 } ) ) return false;
+
+	return true;
+}
+UNITTESTEND( FecTest )
+
+
+UTESTBEGIN( StrandStopTest )
+{
+	sptr<INetwork> nw = INetwork::create( false );
+	JobSystem js( toNetwork( *nw ), 2 );
+	Strand strand( js );
+	atomic<bool> release( false );
+	atomic<u32> numRun( 0 );
+
+	// Callbacks still queued when the JobSystem stops must release what they captured.
+	auto token = make_shared<u32>( 0 );
+	weak_ptr<u32> weakToken = token;
+	strand.post( [&]()
+	{
+		while ( !release ) this_thread::yield();
+	});
+	for ( u32 i=0; i<10; ++i )
+	{
+		strand.post( [token, &numRun]() { numRun++; } );
+	}
+	token.reset();
+	thread releaser( [&]()
+	{
+		this_thread::sleep_for( chrono::milliseconds( 50 ) );
+		release = true;
+	});
+	js.stop();
+	releaser.join();
+	if ( !weakToken.expired() ) return false;
+
+	// Callbacks posted after the stop never run and are released at once.
+	token = make_shared<u32>( 0 );
+	weakToken = token;
+	strand.post( [token, &numRun]() { numRun++; } );
+	token.reset();
+	if ( !weakToken.expired() ) return false;
+	if ( numRun != 0 ) return false;
+
+	return true;
+}
+UNITTESTEND( StrandStopTest )
\ No newline at end of file